@@ -0,0 +1,179 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+   Benchmark of the fixed cost of a call.
+
+   First, without any I/O: the work done by the library before a transfer
+   (bitcoinrpc_call_prepare_()), with the curl handle prepared once, as it
+   is now, and with all its options set again on each call, as it used to be.
+   Then the whole round trip of bitcoinrpc_call() and bitcoinrpc_calln()
+   against a stand-in server on the loopback interface (see:
+   bitcoinrpc_bench_server.h), which answers at once.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+#include "../src/bitcoinrpc.h"
+#include "../src/bitcoinrpc_call.h"
+#include "../src/bitcoinrpc_cl.h"
+#include "bitcoinrpc_bench_server.h"
+
+#define BENCH_PREPARE_ROUNDS 1000000
+#define BENCH_CALL_ROUNDS 20000
+#define BENCH_BATCH 100
+
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* The library's work before a transfer; return ns per call */
+static double
+prepare(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *m, int setup)
+{
+  struct bitcoinrpc_cl_conn_ *conn = bitcoinrpc_cl_conn_get_(cl);
+  double t0;
+
+  if (NULL == conn)
+    return -1.0;
+
+  t0 = now();
+  for (size_t r = 0; r < BENCH_PREPARE_ROUNDS; r++)
+    {
+      if (setup)
+        bitcoinrpc_call_setup_(cl, conn->curl, &conn->curl_resp, conn->curl_errbuf);
+      if (bitcoinrpc_call_prepare_(cl, conn->curl, 1, &m, &conn->curl_resp,
+                                   &conn->sendbuf, &conn->recvbuf, NULL)
+          != BITCOINRPCE_OK)
+        return -1.0;
+    }
+  t0 = now() - t0;
+  bitcoinrpc_cl_conn_put_(cl, conn);
+
+  return t0 * 1e9 / BENCH_PREPARE_ROUNDS;
+}
+
+
+/* Round trips of batches of n; return us per method */
+static double
+call(bitcoinrpc_cl_t *cl, size_t n)
+{
+  bitcoinrpc_method_t *m[BENCH_BATCH];
+  bitcoinrpc_resp_t *r[BENCH_BATCH];
+  bitcoinrpc_err_t e;
+  size_t rounds = BENCH_CALL_ROUNDS / n;
+  double t0 = -1.0;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      r[i] = bitcoinrpc_resp_init();
+      if (NULL == m[i] || NULL == r[i])
+        return -1.0;
+    }
+
+  /* warm up: open the connection */
+  if (bitcoinrpc_calln(cl, n, m, r, &e) != BITCOINRPCE_OK)
+    goto out;
+
+  t0 = now();
+  for (size_t k = 0; k < rounds; k++)
+    if (bitcoinrpc_calln(cl, n, m, r, &e) != BITCOINRPCE_OK)
+      {
+        t0 = -1.0;
+        goto out;
+      }
+  t0 = (now() - t0) * 1e6 / ((double)rounds * n);
+
+out:
+  if (t0 < 0)
+    fprintf(stderr, "call failed: %s\n", e.msg);
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_method_free(m[i]);
+      bitcoinrpc_resp_free(r[i]);
+    }
+
+  return t0;
+}
+
+
+int
+main(void)
+{
+  struct bench_server s;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m = NULL;
+  double prepared, setup, single, batch;
+
+  memset(&s, 0, sizeof s);
+  if (bench_server_start(&s) != 0)
+    {
+      fprintf(stderr, "cannot start the server\n");
+      return EXIT_FAILURE;
+    }
+
+  bitcoinrpc_global_init();
+  cl = bitcoinrpc_cl_init_params("user", "password", "127.0.0.1", s.port);
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+  if (NULL == cl || NULL == m)
+    {
+      fprintf(stderr, "cannot initialise the client\n");
+      return EXIT_FAILURE;
+    }
+
+  prepared = prepare(cl, m, 0);
+  setup = prepare(cl, m, 1);
+  single = call(cl, 1);
+  batch = call(cl, BENCH_BATCH);
+  if (prepared < 0 || setup < 0 || single < 0 || batch < 0)
+    return EXIT_FAILURE;
+
+  printf("%-40s %10.1f ns\n", "prepare, handle set up once", prepared);
+  printf("%-40s %10.1f ns\n", "prepare, handle set up on each call", setup);
+  printf("%-40s %10.2f us\n", "bitcoinrpc_call(), round trip", single);
+  printf("%-40s %10.2f us\n", "bitcoinrpc_calln() of 100, per method", batch);
+
+  bitcoinrpc_method_free(m);
+  bitcoinrpc_cl_free(cl);
+  bitcoinrpc_global_cleanup();
+  bench_server_stop(&s);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+   Benchmark of the buffer receiving data from the server.
+
+   Feed responses of sizes from 1 KB up to 100 MB to the receive buffer in
+   chunks of CURL_MAX_WRITE_SIZE bytes (the way libcurl delivers them)
+   and report the cost per byte: with the buffer reused between rounds
+   (as it is between calls made with the same client) and with a fresh
+   buffer each round (the first call, or a reply bigger than
+   BITCOINRPC_BUF_KEEPMAX).  The old algorithm is shown for comparison.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <curl/curl.h>
+
+#include "../src/bitcoinrpc.h"
+#include "../src/bitcoinrpc_buf.h"
+
+#define BENCH_CHUNK CURL_MAX_WRITE_SIZE
+#define BENCH_MAXSIZE (100 * 1000 * 1000)
+
+/* Total number of bytes to push through the buffer for each response size */
+#define BENCH_VOLUME (400 * 1000 * 1000)
+
+/* The naive (quadratic) algorithm is too slow above this size */
+#define BENCH_NAIVE_MAXSIZE (1000 * 1000)
+
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* What bitcoinrpc_call_write_callback_() used to do: reallocate on each chunk */
+static char *
+naive_append(char *data, size_t *len, const char *ptr, size_t n)
+{
+  char *d = malloc(*len + n + 1);
+  size_t i, j;
+
+  if (NULL == d)
+    abort();
+  for (i = 0; i < *len; i++)
+    d[i] = data[i];
+  for (i = 0, j = 0; i < n; i++)
+    if (ptr[i] != '\n')
+      d[*len + j++] = ptr[i];
+  d[*len + j] = '\0';
+  free(data);
+  *len += j;
+
+  return d;
+}
+
+
+/* Fill src with something that looks like a verbose getblock reply */
+static void
+fill(char *src, size_t size)
+{
+  static const char line[] =
+    "{\"txid\":\"6f7cf9580f1c2dfb3c4d5d043cdbb128c640e3f20161245aa7372e9666168516\"},\n";
+  size_t l = sizeof line - 1;
+
+  for (size_t i = 0; i < size; i += l)
+    memcpy(src + i, line, (size - i < l) ? size - i : l);
+}
+
+
+/* Push size bytes through the buffer, rounds times; return ns per byte */
+static double
+feed(struct bitcoinrpc_buf_ *buf, const char *src, size_t size,
+     size_t rounds, int cold)
+{
+  double t0 = now();
+
+  for (size_t r = 0; r < rounds; r++)
+    {
+      if (cold)
+        bitcoinrpc_buf_free_(buf);
+      else
+        bitcoinrpc_buf_clear_(buf);
+
+      for (size_t off = 0; off < size; off += BENCH_CHUNK)
+        {
+          size_t n = (size - off < BENCH_CHUNK) ? size - off : BENCH_CHUNK;
+          if (bitcoinrpc_buf_append_nonl_(buf, src + off, n) != BITCOINRPCE_OK)
+            return -1.0;
+        }
+    }
+  bitcoinrpc_buf_free_(buf);
+
+  return (now() - t0) * 1e9 / ((double)size * rounds);
+}
+
+
+int
+main(void)
+{
+  static const size_t sizes[] = {
+    1000, 10 * 1000, 100 * 1000, 1000 * 1000,
+    10 * 1000 * 1000, 100 * 1000 * 1000
+  };
+  struct bitcoinrpc_buf_ buf;
+  char *src = malloc(BENCH_MAXSIZE);
+
+  if (NULL == src)
+    {
+      fprintf(stderr, "cannot allocate memory\n");
+      return EXIT_FAILURE;
+    }
+  fill(src, BENCH_MAXSIZE);
+  bitcoinrpc_buf_init_(&buf);
+
+  printf("%12s %8s %14s %14s %14s\n",
+         "size [B]", "rounds", "reused ns/B", "cold ns/B", "naive ns/B");
+  for (size_t k = 0; k < sizeof sizes / sizeof sizes[0]; k++)
+    {
+      size_t size = sizes[k];
+      size_t rounds = BENCH_VOLUME / size;
+      double reused, cold, naive = -1.0;
+
+      reused = feed(&buf, src, size, rounds, 0);
+      cold = feed(&buf, src, size, rounds, 1);
+
+      if (size <= BENCH_NAIVE_MAXSIZE)
+        {
+          size_t nrounds = rounds / 10 + 1;
+          double n0 = now();
+          for (size_t r = 0; r < nrounds; r++)
+            {
+              char *data = NULL;
+              size_t len = 0;
+              for (size_t off = 0; off < size; off += BENCH_CHUNK)
+                {
+                  size_t n = (size - off < BENCH_CHUNK) ? size - off : BENCH_CHUNK;
+                  data = naive_append(data, &len, src + off, n);
+                }
+              free(data);
+            }
+          naive = (now() - n0) * 1e9 / ((double)size * nrounds);
+        }
+
+      if (reused < 0 || cold < 0)
+        {
+          fprintf(stderr, "cannot allocate memory\n");
+          return EXIT_FAILURE;
+        }
+      printf("%12zu %8zu %14.3f %14.3f ", size, rounds, reused, cold);
+      if (naive < 0)
+        printf("%14s\n", "-");
+      else
+        printf("%14.3f\n", naive);
+    }
+
+  bitcoinrpc_buf_free_(&buf);
+  free(src);
+
+  return EXIT_SUCCESS;
+}
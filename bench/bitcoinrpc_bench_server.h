@@ -0,0 +1,492 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+   A stand-in for bitcoind: a minimal HTTP/1.1 server answering JSON-RPC
+   batches on 127.0.0.1, so that benchmarks measure the library rather than
+   the node.  Every request of a batch gets a canned result, with its id
+   copied as is; the order of the batch is kept:
+
+     getblockcount   700000
+     getblock        a verbose block (verbosity 2) of block_txs transactions
+     getrawmempool   an array of mempool_txs txids
+     anything else   0
+
+   Each connection is served by its own thread, with keep-alive.
+   Include it in a benchmark compiled with _POSIX_C_SOURCE >= 200809L.
+ */
+
+#ifndef BITCOINRPC_BENCH_SERVER_H_3f0c5d52_8a7e_4b61_9d3c_2e6f1a4b7c90
+#define BITCOINRPC_BENCH_SERVER_H_3f0c5d52_8a7e_4b61_9d3c_2e6f1a4b7c90
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+struct bench_server {
+  /* set these before bench_server_start() */
+  size_t block_txs;
+  size_t mempool_txs;
+
+  int fd;                   /* listening socket */
+  unsigned int port;        /* chosen by the system */
+  pthread_t thread;
+
+  char *block;              /* canned results */
+  size_t block_len;
+  char *mempool;
+  size_t mempool_len;
+
+  unsigned long long bytes_sent;    /* updated atomically */
+};
+
+struct bench_server_conn_arg_ {
+  struct bench_server *s;
+  int fd;
+};
+
+
+/* Send all n bytes */
+static int
+bench_server_send_(int fd, const char *data, size_t n)
+{
+  ssize_t k;
+
+  while (n > 0)
+    {
+      k = send(fd, data, n, MSG_NOSIGNAL);
+      if (k < 0 && EINTR == errno)
+        continue;
+      if (k <= 0)
+        return -1;
+      data += k;
+      n -= (size_t)k;
+    }
+
+  return 0;
+}
+
+
+/* Make sure there is room for n more bytes in *buf */
+static int
+bench_server_grow_(char **buf, size_t *cap, size_t len, size_t n)
+{
+  char *p = NULL;
+
+  if (len + n + 1 <= *cap)
+    return 0;
+  while (len + n + 1 > *cap)
+    *cap *= 2;
+  p = realloc(*buf, *cap);
+  if (NULL == p)
+    return -1;
+  *buf = p;
+
+  return 0;
+}
+
+
+/* Append formatted text to *buf */
+static int
+bench_server_printf_(char **buf, size_t *cap, size_t *len, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  for (;;)
+    {
+      va_start(ap, fmt);
+      n = vsnprintf(*buf + *len, *cap - *len, fmt, ap);
+      va_end(ap);
+      if (n < 0)
+        return -1;
+      if (*len + (size_t)n < *cap)
+        break;
+      if (bench_server_grow_(buf, cap, *len, (size_t)n) != 0)
+        return -1;
+    }
+  *len += (size_t)n;
+
+  return 0;
+}
+
+
+/* 64 hex digits that look random enough */
+static int
+bench_server_hash_(char **buf, size_t *cap, size_t *len, unsigned long long seed)
+{
+  unsigned long long x[4];
+
+  for (int i = 0; i < 4; i++)
+    {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      x[i] = seed ^ (seed >> 29);
+    }
+
+  return bench_server_printf_(buf, cap, len, "%016llx%016llx%016llx%016llx",
+                              x[0], x[1], x[2], x[3]);
+}
+
+
+/* Make the results of getblock and getrawmempool */
+static int
+bench_server_canned_(struct bench_server *s)
+{
+  size_t cap = 1 << 16;
+  size_t len = 0;
+  char *b = NULL;
+  int e = 0;
+
+  b = malloc(cap);
+  if (NULL == b)
+    return -1;
+  e |= bench_server_printf_(&b, &cap, &len, "{\"hash\":\"");
+  e |= bench_server_hash_(&b, &cap, &len, 1);
+  e |= bench_server_printf_(&b, &cap, &len,
+         "\",\"confirmations\":1,\"height\":700000,\"version\":536870912,"
+         "\"time\":1631333672,\"nonce\":2881644503,\"bits\":\"170f48e4\","
+         "\"difficulty\":18415156832118.24,\"nTx\":%zu,\"tx\":[", s->block_txs);
+  for (size_t i = 0; i < s->block_txs && 0 == e; i++)
+    {
+      e |= bench_server_printf_(&b, &cap, &len, "%s{\"txid\":\"", i > 0 ? "," : "");
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 2);
+      e |= bench_server_printf_(&b, &cap, &len, "\",\"hash\":\"");
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 3);
+      e |= bench_server_printf_(&b, &cap, &len,
+             "\",\"version\":2,\"size\":222,\"vsize\":141,\"weight\":561,"
+             "\"locktime\":0,\"vin\":[{\"txid\":\"");
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 4);
+      e |= bench_server_printf_(&b, &cap, &len,
+             "\",\"vout\":%zu,\"scriptSig\":{\"asm\":\"\",\"hex\":\"\"},"
+             "\"txinwitness\":[\"", i % 4);
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 5);
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 6);
+      e |= bench_server_printf_(&b, &cap, &len,
+             "\"],\"sequence\":4294967295}],\"vout\":[{\"value\":0.%08zu,"
+             "\"n\":0,\"scriptPubKey\":{\"asm\":\"0 ", (i * 7919) % 100000000);
+      e |= bench_server_hash_(&b, &cap, &len, 2 * i + 7);
+      e |= bench_server_printf_(&b, &cap, &len,
+             "\",\"type\":\"witness_v0_scripthash\"}}]}");
+    }
+  e |= bench_server_printf_(&b, &cap, &len, "]}");
+  if (e != 0)
+    {
+      free(b);
+      return -1;
+    }
+  s->block = b;
+  s->block_len = len;
+
+  cap = 1 << 16;
+  len = 0;
+  b = malloc(cap);
+  if (NULL == b)
+    return -1;
+  e |= bench_server_printf_(&b, &cap, &len, "[");
+  for (size_t i = 0; i < s->mempool_txs && 0 == e; i++)
+    {
+      e |= bench_server_printf_(&b, &cap, &len, "%s\"", i > 0 ? "," : "");
+      e |= bench_server_hash_(&b, &cap, &len, i + 1000000007ULL);
+      e |= bench_server_printf_(&b, &cap, &len, "\"");
+    }
+  e |= bench_server_printf_(&b, &cap, &len, "]");
+  if (e != 0)
+    {
+      free(b);
+      return -1;
+    }
+  s->mempool = b;
+  s->mempool_len = len;
+
+  return 0;
+}
+
+
+/*
+   Write the response to the batch in body: for each request (as serialised
+   by the library: "method" first, "id" last), the result of the method
+   with the same id.
+ */
+static int
+bench_server_reply_(struct bench_server *s, const char *body,
+                    char **out, size_t *cap, size_t *len)
+{
+  static const char mkey[] = "\"method\":\"";
+  static const char ikey[] = "\"id\":";
+  static const char res[] = "{\"result\":";
+  static const char err[] = ",\"error\":null,\"id\":";
+  const char *p = body;
+  const char *name = NULL;
+  const char *end = NULL;
+  const char *result = NULL;
+  size_t result_len;
+  int first = 1;
+
+  *len = 0;
+  if (bench_server_grow_(out, cap, *len, 1) != 0)
+    return -1;
+  (*out)[(*len)++] = '[';
+
+  while (NULL != (p = strstr(p, mkey)))
+    {
+      name = p + sizeof mkey - 1;
+      if (strncmp(name, "getblockcount\"", 14) == 0)
+        result = "700000";
+      else if (strncmp(name, "getblock\"", 9) == 0)
+        result = s->block;
+      else if (strncmp(name, "getrawmempool\"", 14) == 0)
+        result = s->mempool;
+      else
+        result = "0";
+      result_len = (result == s->block) ? s->block_len
+                   : (result == s->mempool) ? s->mempool_len : strlen(result);
+
+      p = strstr(name, ikey);
+      if (NULL == p)
+        break;
+      p += sizeof ikey - 1;
+      end = strchr(p, '}');
+      if (NULL == end)
+        break;
+
+      if (bench_server_grow_(out, cap, *len, sizeof res + result_len + sizeof err
+                             + (size_t)(end - p) + 2) != 0)
+        return -1;
+      if (!first)
+        (*out)[(*len)++] = ',';
+      first = 0;
+      memcpy(*out + *len, res, sizeof res - 1);
+      *len += sizeof res - 1;
+      memcpy(*out + *len, result, result_len);
+      *len += result_len;
+      memcpy(*out + *len, err, sizeof err - 1);
+      *len += sizeof err - 1;
+      memcpy(*out + *len, p, (size_t)(end - p));
+      *len += (size_t)(end - p);
+      (*out)[(*len)++] = '}';
+      p = end;
+    }
+
+  if (bench_server_grow_(out, cap, *len, 1) != 0)
+    return -1;
+  (*out)[(*len)++] = ']';
+
+  return 0;
+}
+
+
+/* Serve one connection until the client closes it */
+static void *
+bench_server_conn_(void *arg)
+{
+  struct bench_server *s = ((struct bench_server_conn_arg_ *)arg)->s;
+  int fd = ((struct bench_server_conn_arg_ *)arg)->fd;
+  size_t cap = 1 << 16, len = 0, outcap = 1 << 16, outlen = 0;
+  char *buf = malloc(cap);
+  char *out = malloc(outcap);
+  char head[128];
+  int one = 1;
+
+  free(arg);
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+  if (NULL == buf || NULL == out)
+    goto done;
+  buf[0] = '\0';
+
+  for (;;)
+    {
+      char *eoh = NULL;
+      char *cl = NULL;
+      size_t hlen, blen;
+      ssize_t k;
+
+      /* headers */
+      while (NULL == (eoh = strstr(buf, "\r\n\r\n")))
+        {
+          if (bench_server_grow_(&buf, &cap, len, 1 << 14) != 0)
+            goto done;
+          k = recv(fd, buf + len, cap - len - 1, 0);
+          if (k <= 0)
+            goto done;
+          len += (size_t)k;
+          buf[len] = '\0';
+        }
+      hlen = (size_t)(eoh - buf) + 4;
+
+      blen = 0;
+      for (cl = buf; cl < eoh; cl++)
+        if (strncasecmp(cl, "\r\ncontent-length:", 17) == 0)
+          {
+            blen = strtoul(cl + 17, NULL, 10);
+            break;
+          }
+
+      /* body */
+      while (len < hlen + blen)
+        {
+          if (bench_server_grow_(&buf, &cap, len, hlen + blen - len) != 0)
+            goto done;
+          k = recv(fd, buf + len, cap - len - 1, 0);
+          if (k <= 0)
+            goto done;
+          len += (size_t)k;
+        }
+
+      /* the body is followed by the next request, if any */
+      char c = buf[hlen + blen];
+      buf[hlen + blen] = '\0';
+      if (bench_server_reply_(s, buf + hlen, &out, &outcap, &outlen) != 0)
+        goto done;
+      buf[hlen + blen] = c;
+
+      snprintf(head, sizeof head,
+               "HTTP/1.1 200 OK\r\n"
+               "Content-Type: application/json\r\n"
+               "Content-Length: %zu\r\n\r\n", outlen);
+      if (bench_server_send_(fd, head, strlen(head)) != 0
+          || bench_server_send_(fd, out, outlen) != 0)
+        goto done;
+      __sync_add_and_fetch(&s->bytes_sent,
+                           (unsigned long long)(strlen(head) + outlen));
+
+      memmove(buf, buf + hlen + blen, len - hlen - blen);
+      len -= hlen + blen;
+      buf[len] = '\0';
+    }
+
+done:
+  close(fd);
+  free(buf);
+  free(out);
+  return NULL;
+}
+
+
+static void *
+bench_server_accept_(void *arg)
+{
+  struct bench_server *s = arg;
+  struct bench_server_conn_arg_ *a = NULL;
+  pthread_t t;
+  int fd;
+
+  for (;;)
+    {
+      fd = accept(s->fd, NULL, NULL);
+      if (fd < 0)
+        {
+          if (EINTR == errno || ECONNABORTED == errno)
+            continue;
+          return NULL;          /* bench_server_stop() */
+        }
+      a = malloc(sizeof *a);
+      if (NULL == a)
+        {
+          close(fd);
+          continue;
+        }
+      a->s = s;
+      a->fd = fd;
+      if (pthread_create(&t, NULL, bench_server_conn_, a) != 0)
+        {
+          free(a);
+          close(fd);
+          continue;
+        }
+      pthread_detach(t);
+    }
+}
+
+
+/* Listen on 127.0.0.1 at a free port; return 0 on success */
+static int
+bench_server_start(struct bench_server *s)
+{
+  struct sockaddr_in sa;
+  socklen_t salen = sizeof sa;
+  int one = 1;
+
+  s->block = NULL;
+  s->mempool = NULL;
+  s->bytes_sent = 0;
+  if (bench_server_canned_(s) != 0)
+    {
+      free(s->block);
+      return -1;
+    }
+
+  s->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (s->fd < 0)
+    return -1;
+  setsockopt(s->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+  memset(&sa, 0, sizeof sa);
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = 0;
+  if (bind(s->fd, (struct sockaddr *)&sa, sizeof sa) != 0
+      || listen(s->fd, 128) != 0
+      || getsockname(s->fd, (struct sockaddr *)&sa, &salen) != 0)
+    {
+      close(s->fd);
+      return -1;
+    }
+  s->port = ntohs(sa.sin_port);
+
+  if (pthread_create(&s->thread, NULL, bench_server_accept_, s) != 0)
+    {
+      close(s->fd);
+      return -1;
+    }
+
+  return 0;
+}
+
+
+/*
+   Stop accepting connections.  The open ones end when the client closes
+   them, so close the clients first: the canned results are freed.
+ */
+static void
+bench_server_stop(struct bench_server *s)
+{
+  shutdown(s->fd, SHUT_RDWR);
+  close(s->fd);
+  pthread_join(s->thread, NULL);
+  free(s->block);
+  free(s->mempool);
+}
+
+#endif /* BITCOINRPC_BENCH_SERVER_H_3f0c5d52_8a7e_4b61_9d3c_2e6f1a4b7c90 */
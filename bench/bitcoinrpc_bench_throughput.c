@@ -0,0 +1,212 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+   Throughput of the client against a stand-in server on the loopback
+   interface (see: bitcoinrpc_bench_server.h).
+
+   For bitcoinrpc_call() of getblockcount, getblock (a verbose block) and
+   getrawmempool, and for bitcoinrpc_calln() of getblockcount in batches of
+   1 up to 10,000, report calls per second (methods, for a batch), the
+   median and 99th percentile of the latency of a call, and the bytes per
+   second received.  Each row runs for about BENCH_SECONDS.
+
+   Usage: bitcoinrpc_bench_throughput [block_txs [mempool_txs]]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <jansson.h>
+
+#include "../src/bitcoinrpc.h"
+#include "bitcoinrpc_bench_server.h"
+
+#define BENCH_SECONDS 2.0
+#define BENCH_MAXROUNDS 1000000
+#define BENCH_MAXBATCH 10000
+
+#define BENCH_BLOCK_TXS 2500
+#define BENCH_MEMPOOL_TXS 50000
+
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int
+cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+
+/* Call n methods in batches until BENCH_SECONDS have passed; print a row */
+static int
+run(const char *label, bitcoinrpc_cl_t *cl, struct bench_server *s,
+    size_t n, bitcoinrpc_method_t **m, bitcoinrpc_resp_t **r, double *lat)
+{
+  bitcoinrpc_err_t e;
+  unsigned long long bytes;
+  size_t rounds = 0;
+  double t0, t1, t;
+
+  /* warm up: open the connection, grow the buffers */
+  if (bitcoinrpc_calln(cl, n, m, r, &e) != BITCOINRPCE_OK)
+    {
+      fprintf(stderr, "%s: %s\n", label, e.msg);
+      return -1;
+    }
+
+  bytes = s->bytes_sent;
+  t0 = t = now();
+  while (t - t0 < BENCH_SECONDS && rounds < BENCH_MAXROUNDS)
+    {
+      if (bitcoinrpc_calln(cl, n, m, r, &e) != BITCOINRPCE_OK)
+        {
+          fprintf(stderr, "%s: %s\n", label, e.msg);
+          return -1;
+        }
+      t1 = now();
+      lat[rounds++] = t1 - t;
+      t = t1;
+    }
+  bytes = s->bytes_sent - bytes;
+  t -= t0;
+
+  qsort(lat, rounds, sizeof *lat, cmp_double);
+  printf("%-28s %8zu %12.0f %10.1f %10.1f %10.1f\n", label, rounds,
+         rounds * n / t, lat[rounds / 2] * 1e6, lat[rounds * 99 / 100] * 1e6,
+         bytes / t / 1e6);
+
+  return 0;
+}
+
+
+int
+main(int argc, char **argv)
+{
+  static const size_t batches[] = { 1, 10, 100, 1000, BENCH_MAXBATCH };
+  struct bench_server s;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t **m = NULL;
+  bitcoinrpc_resp_t **r = NULL;
+  bitcoinrpc_method_t *single = NULL;
+  json_t *params = NULL;
+  double *lat = NULL;
+  char label[64];
+  int ret = EXIT_FAILURE;
+
+  memset(&s, 0, sizeof s);
+  s.block_txs = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_BLOCK_TXS;
+  s.mempool_txs = (argc > 2) ? strtoul(argv[2], NULL, 10) : BENCH_MEMPOOL_TXS;
+  if (bench_server_start(&s) != 0)
+    {
+      fprintf(stderr, "cannot start the server\n");
+      return EXIT_FAILURE;
+    }
+
+  bitcoinrpc_global_init();
+  cl = bitcoinrpc_cl_init_params("user", "password", "127.0.0.1", s.port);
+  m = calloc(BENCH_MAXBATCH, sizeof *m);
+  r = calloc(BENCH_MAXBATCH, sizeof *r);
+  lat = malloc(BENCH_MAXROUNDS * sizeof *lat);
+  if (NULL == cl || NULL == m || NULL == r || NULL == lat)
+    {
+      fprintf(stderr, "cannot initialise the client\n");
+      goto out;
+    }
+  for (size_t i = 0; i < BENCH_MAXBATCH; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      r[i] = bitcoinrpc_resp_init();
+      if (NULL == m[i] || NULL == r[i])
+        {
+          fprintf(stderr, "cannot initialise the methods\n");
+          goto out;
+        }
+    }
+
+  printf("getblock: %zu transactions, %zu bytes; getrawmempool: %zu txids, %zu bytes\n\n",
+         s.block_txs, s.block_len, s.mempool_txs, s.mempool_len);
+  printf("%-28s %8s %12s %10s %10s %10s\n",
+         "", "calls", "methods/s", "p50 [us]", "p99 [us]", "MB/s");
+
+  if (run("call getblockcount", cl, &s, 1, m, r, lat) != 0)
+    goto out;
+
+  params = json_pack("[s, i]",
+                     "0000000000000000000b4d0b2e8e7e4a5fdc8f9e2b9a4d9c1c2e0a6b2f3d5e7f", 2);
+  single = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_GETBLOCK, params);
+  json_decref(params);
+  if (NULL == single || run("call getblock", cl, &s, 1, &single, r, lat) != 0)
+    goto out;
+  bitcoinrpc_method_free(single);
+
+  single = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETRAWMEMPOOL);
+  if (NULL == single || run("call getrawmempool", cl, &s, 1, &single, r, lat) != 0)
+    goto out;
+
+  for (size_t k = 0; k < sizeof batches / sizeof batches[0]; k++)
+    {
+      snprintf(label, sizeof label, "calln getblockcount x%zu", batches[k]);
+      if (run(label, cl, &s, batches[k], m, r, lat) != 0)
+        goto out;
+    }
+
+  ret = EXIT_SUCCESS;
+
+out:
+  bitcoinrpc_method_free(single);
+  for (size_t i = 0; NULL != m && i < BENCH_MAXBATCH; i++)
+    {
+      if (NULL != m[i])
+        bitcoinrpc_method_free(m[i]);
+      if (NULL != r[i])
+        bitcoinrpc_resp_free(r[i]);
+    }
+  free(m);
+  free(r);
+  free(lat);
+  if (NULL != cl)
+    bitcoinrpc_cl_free(cl);
+  bitcoinrpc_global_cleanup();
+  bench_server_stop(&s);
+
+  return ret;
+}
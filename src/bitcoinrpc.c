@@ -22,27 +22,242 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <curl/curl.h>
 #include <jansson.h>
 #include <uuid/uuid.h>
 
 #include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+#include "bitcoinrpc_cache.h"
+#include "bitcoinrpc_call.h"
 #include "bitcoinrpc_cl.h"
 #include "bitcoinrpc_err.h"
+#include "bitcoinrpc_flight.h"
 #include "bitcoinrpc_global.h"
+#include "bitcoinrpc_hedge.h"
+#include "bitcoinrpc_limit.h"
 #include "bitcoinrpc_method.h"
+#include "bitcoinrpc_node.h"
 #include "bitcoinrpc_resp.h"
+#include "bitcoinrpc_stats.h"
 
 
 
-struct bitcoinrpc_call_curl_resp_ {
-  char* data;
-  unsigned long long int data_len;
-  int called_before;
-  bitcoinrpc_err_t e;
-};
+double
+bitcoinrpc_call_now_(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void
+bitcoinrpc_call_sleep_(double seconds)
+{
+  struct timespec ts;
+
+  ts.tv_sec = (time_t)seconds;
+  ts.tv_nsec = (long)((seconds - ts.tv_sec) * 1e9);
+  while (nanosleep(&ts, &ts) != 0 && EINTR == errno)
+    ;
+}
+
+
+/* How long to wait before sending again a call refused by the server tries times */
+static double
+bitcoinrpc_call_backoff_(size_t tries)
+{
+  return BITCOINRPC_LIMIT_RETRY_WAIT_ * (double)(1u << tries);
+}
+
+
+void
+bitcoinrpc_call_curl_resp_init_(struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                                struct bitcoinrpc_buf_ *buf)
+{
+  curl_resp->buf = buf;
+  curl_resp->e.code = BITCOINRPCE_OK;
+  bitcoinrpc_buf_clear_(buf);
+
+  curl_resp->batch = NULL;
+  curl_resp->state = BITCOINRPC_CALL_STREAM_START;
+  curl_resp->scan = 0;
+  curl_resp->start = 0;
+  curl_resp->depth = 0;
+  curl_resp->in_elem = 0;
+  curl_resp->in_str = 0;
+  curl_resp->esc = 0;
+  curl_resp->comma = 0;
+  curl_resp->nelems = 0;
+  curl_resp->sink = NULL;
+  memset(&curl_resp->timings, 0, sizeof curl_resp->timings);
+  curl_resp->nsizes = 0;
+}
+
+
+/* Whitespace allowed by JSON */
+#define BITCOINRPC_CALL_ISSPACE_(c) \
+  (' ' == (c) || '\t' == (c) || '\n' == (c) || '\r' == (c))
+
+
+static BITCOINRPCEcode
+bitcoinrpc_call_sink_put_(struct bitcoinrpc_call_curl_resp_ *r, json_t *j, size_t bytes);
+
+
+/* Parse the element ending at end and drop it from the buffer */
+static BITCOINRPCEcode
+bitcoinrpc_call_stream_elem_(struct bitcoinrpc_call_curl_resp_ *r, size_t end)
+{
+  struct bitcoinrpc_buf_ *b = r->buf;
+  BITCOINRPCEcode ecode;
+  json_t *j = NULL;
+  json_error_t jerr;
+
+  j = json_loadb(b->data + r->start, end - r->start, 0, &jerr);
+  if (NULL == j)
+    return BITCOINRPCE_JSON;
+  if (r->nelems < r->nsizes)
+    r->sizes[r->nelems] = end - r->start;
+  r->nelems++;
+  if (NULL != r->sink)
+    {
+      ecode = bitcoinrpc_call_sink_put_(r, j, end - r->start);
+      json_decref(j);
+      if (ecode != BITCOINRPCE_OK)
+        return ecode;
+    }
+  else if (json_array_append_new(r->batch, j) != 0)
+    {
+      return BITCOINRPCE_ALLOC;
+    }
+
+  memmove(b->data, b->data + end, b->len - end);
+  b->len -= end;
+  b->data[b->len] = '\0';
+  r->scan -= end;
+  r->in_elem = 0;
+
+  return BITCOINRPCE_OK;
+}
+
+
+/*
+   Scan the data received so far.  The batch is a JSON array; find where its
+   elements end (outside of strings and nested structures) and parse them.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_call_stream_(struct bitcoinrpc_call_curl_resp_ *r)
+{
+  struct bitcoinrpc_buf_ *b = r->buf;
+  BITCOINRPCEcode ecode;
+  char c;
+
+  while (r->scan < b->len)
+    {
+      c = b->data[r->scan++];
+
+      if (r->in_str)
+        {
+          if (r->esc)
+            r->esc = 0;
+          else if ('\\' == c)
+            r->esc = 1;
+          else if ('"' == c)
+            r->in_str = 0;
+          continue;
+        }
+
+      switch (r->state)
+        {
+        case BITCOINRPC_CALL_STREAM_START:
+          if (BITCOINRPC_CALL_ISSPACE_(c))
+            continue;
+          if (c != '[')
+            {
+              r->state = BITCOINRPC_CALL_STREAM_RAW;
+              return BITCOINRPCE_OK;
+            }
+          r->batch = json_array();
+          if (NULL == r->batch)
+            return BITCOINRPCE_ALLOC;
+          r->state = BITCOINRPC_CALL_STREAM_ARRAY;
+          continue;
+
+        case BITCOINRPC_CALL_STREAM_ARRAY:
+          if (0 == r->depth)
+            {
+              if (BITCOINRPC_CALL_ISSPACE_(c) && !r->in_elem)
+                continue;
+              if (',' == c || ']' == c)
+                {
+                  /* a scalar ends here */
+                  if (r->in_elem)
+                    {
+                      ecode = bitcoinrpc_call_stream_elem_(r, r->scan - 1);
+                      if (ecode != BITCOINRPCE_OK)
+                        return ecode;
+                    }
+                  else if (r->comma || (',' == c && 0 == r->nelems))
+                    {
+                      return BITCOINRPCE_JSON;
+                    }
+                  r->comma = (',' == c);
+                  if (']' == c)
+                    r->state = BITCOINRPC_CALL_STREAM_DONE;
+                  continue;
+                }
+              if (!r->in_elem)
+                {
+                  if (!r->comma && r->nelems > 0)
+                    return BITCOINRPCE_JSON;
+                  r->in_elem = 1;
+                  r->comma = 0;
+                  r->start = r->scan - 1;
+                }
+            }
+
+          if ('"' == c)
+            {
+              r->in_str = 1;
+            }
+          else if ('{' == c || '[' == c)
+            {
+              r->depth++;
+            }
+          else if ('}' == c || ']' == c)
+            {
+              if (0 == r->depth)
+                return BITCOINRPCE_JSON;
+              if (0 == --r->depth)
+                {
+                  ecode = bitcoinrpc_call_stream_elem_(r, r->scan);
+                  if (ecode != BITCOINRPCE_OK)
+                    return ecode;
+                }
+            }
+          continue;
+
+        case BITCOINRPC_CALL_STREAM_DONE:
+          if (!BITCOINRPC_CALL_ISSPACE_(c))
+            return BITCOINRPCE_JSON;
+          continue;
+
+        case BITCOINRPC_CALL_STREAM_RAW:
+          return BITCOINRPCE_OK;
+        }
+    }
+
+  return BITCOINRPCE_OK;
+}
 
 
 size_t
@@ -50,185 +265,1435 @@ bitcoinrpc_call_write_callback_(char *ptr, size_t size, size_t nmemb, void *user
 {
   size_t n = size * nmemb;
   struct bitcoinrpc_call_curl_resp_ *curl_resp = (struct bitcoinrpc_call_curl_resp_*)userdata;
+  BITCOINRPCEcode ecode;
+  double t0;
 
-  if (!curl_resp->called_before)
-    {
-      /* initialise the data structure */
-      curl_resp->called_before = 1;
-      curl_resp->data_len = 0;
-      curl_resp->data = NULL;
-      curl_resp->e.code = BITCOINRPCE_OK;
-    }
-
-  char * data = NULL;
-  unsigned long long int data_len = curl_resp->data_len + n + 1;
-  data = bitcoinrpc_global_allocfunc(data_len);
-  if (NULL == data)
+  /* do not copy '\n' */
+  if (bitcoinrpc_buf_append_nonl_(curl_resp->buf, ptr, n) != BITCOINRPCE_OK)
     {
-      if (curl_resp->data != NULL)
-        bitcoinrpc_global_freefunc(curl_resp->data);
       curl_resp->e.code = BITCOINRPCE_ALLOC;
       snprintf(curl_resp->e.msg, BITCOINRPC_ERRMSG_MAXLEN,
                "cannot allocate more memory");
       return 0;
     }
-  /* concatenate old and new data */
-  if (NULL != curl_resp->data)
+
+  if (BITCOINRPC_CALL_STREAM_RAW == curl_resp->state)
+    return n;
+
+  /* parse while the rest of the data is still on its way */
+  t0 = bitcoinrpc_call_now_();
+  ecode = bitcoinrpc_call_stream_(curl_resp);
+  curl_resp->timings.parse += bitcoinrpc_call_now_() - t0;
+  if (BITCOINRPCE_OK == ecode && bitcoinrpc_global_over_limit_())
+    ecode = BITCOINRPCE_ALLOC;    /* jansson is not made to fail: see bitcoinrpc_global.c */
+  if (ecode != BITCOINRPCE_OK && curl_resp->e.code != BITCOINRPCE_OK)
+    return 0;     /* stopped by the sink, which has said why */
+  if (ecode != BITCOINRPCE_OK)
     {
-      /* do not copy last '\0' */
-      size_t i;
-      for (i = 0; i < curl_resp->data_len; i++)
-        {
-          data[i] = curl_resp->data[i];
-        }
+      curl_resp->e.code = (BITCOINRPCE_ALLOC == ecode) ? ecode : BITCOINRPCE_CURLE;
+      if (BITCOINRPCE_ALLOC == ecode)
+        snprintf(curl_resp->e.msg, BITCOINRPC_ERRMSG_MAXLEN,
+                 "cannot allocate more memory");
+      else
+        snprintf(curl_resp->e.msg, BITCOINRPC_ERRMSG_MAXLEN,
+                 "cannot parse JSON data from the server: %s", curl_resp->buf->data);
+      return 0;
     }
 
-  /* do not copy '\n' */
-  size_t i, j;
-  for (i = 0, j = 0; i < n; i++)
+  return n;
+}
+
+
+void
+bitcoinrpc_call_setup_(bitcoinrpc_cl_t *cl, CURL *curl,
+                       struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                       char *curl_errbuf)
+{
+  char credentials[2 * BITCOINRPC_PARAM_MAXLEN + 1];
+
+  /*
+     The url is set when the client is initialised and does not change,
+     so it can be read concurrently (bitcoinrpc_cl_get_url() rewrites it).
+     curl keeps its own copies of the strings.
+   */
+  curl_easy_setopt(curl, CURLOPT_URL, cl->url);
+
+  snprintf(credentials, 2 * BITCOINRPC_PARAM_MAXLEN + 1,
+           "%s:%s", cl->user, cl->pass);
+  curl_easy_setopt(curl, CURLOPT_USERPWD, credentials);
+
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, cl->curl_headers);
+  curl_easy_setopt(curl, CURLOPT_USE_SSL, CURLUSESSL_TRY);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_errbuf);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, bitcoinrpc_call_write_callback_);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, curl_resp);
+
+  curl_resp->batch = NULL;
+  bitcoinrpc_buf_init_(&curl_resp->arena);
+}
+
+
+/* Slots of the index of the ids of a batch: a power of two >= 2n */
+static size_t
+bitcoinrpc_call_index_size_(size_t n)
+{
+  size_t size = 1;
+
+  while (size < 2 * n)
+    size <<= 1;
+
+  return size;
+}
+
+
+/* The scratch memory of a call of n methods, see: bitcoinrpc_call_curl_resp_ */
+static size_t
+bitcoinrpc_call_scratch_size_(bitcoinrpc_cl_t *cl, size_t n)
+{
+  size_t size = 0;
+
+  if (NULL != cl->stats)
+    size += n * sizeof(size_t) + BITCOINRPC_BUF_ALIGN;
+  if (n > 1)
+    size += bitcoinrpc_call_index_size_(n) * sizeof(size_t) + BITCOINRPC_BUF_ALIGN;
+
+  return size;
+}
+
+
+/* Identify n methods, as the client does */
+static BITCOINRPCEcode
+bitcoinrpc_call_set_ids_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods)
+{
+  if (BITCOINRPC_ID_COUNTER == cl->idmode)
     {
-      if (ptr[i] != '\n')
-        data[curl_resp->data_len + j++] = ptr[i];
-    }
-  data[curl_resp->data_len + j] = '\0';
+      /* reserve n ids at once; the client may be shared by many threads */
+      json_int_t id = __sync_add_and_fetch(&cl->last_id, (json_int_t)n) - (json_int_t)n;
 
-  if (NULL != curl_resp->data)
+      for (size_t i = 0; i < n; i++)
+        if (bitcoinrpc_method_set_id_(methods[i], ++id) != BITCOINRPCE_OK)
+          return BITCOINRPCE_JSON;
+    }
+  else
     {
-      bitcoinrpc_global_freefunc(curl_resp->data);
+      for (size_t i = 0; i < n; i++)
+        if (bitcoinrpc_method_set_uuid_(methods[i]) != BITCOINRPCE_OK)
+          return BITCOINRPCE_JSON;
     }
 
-  curl_resp->data = data;
-  curl_resp->data_len += j;
+  return BITCOINRPCE_OK;
+}
 
-  return n;
+
+/* Make curl send the batch of n methods written in sendbuf */
+static BITCOINRPCEcode
+bitcoinrpc_call_arm_(bitcoinrpc_cl_t *cl, CURL *curl, size_t n,
+                     struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                     struct bitcoinrpc_buf_ *sendbuf,
+                     struct bitcoinrpc_buf_ *recvbuf,
+                     bitcoinrpc_err_t *e)
+{
+  size_t scratch;
+
+  /* everything else has been set by bitcoinrpc_call_setup_() */
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)sendbuf->len);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, sendbuf->data);
+  bitcoinrpc_call_curl_resp_init_(curl_resp, recvbuf);
+
+  /*
+     Make room in the arena for all the scratch memory of the call at once
+     (the statistics count bytes per method), so that the arena does not
+     move while the call is in progress.
+   */
+  scratch = bitcoinrpc_call_scratch_size_(cl, n);
+  bitcoinrpc_buf_clear_(&curl_resp->arena);
+  if (scratch > 0 && bitcoinrpc_buf_reserve_(&curl_resp->arena, scratch) != BITCOINRPCE_OK)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+  if (NULL != cl->stats)
+    {
+      curl_resp->sizes = bitcoinrpc_buf_alloc_(&curl_resp->arena, n * sizeof *curl_resp->sizes);
+      curl_resp->nsizes = n;
+    }
+
+  bitcoinrpc_RETURN_OK;
 }
 
 
 BITCOINRPCEcode
-bitcoinrpc_call(bitcoinrpc_cl_t * cl, bitcoinrpc_method_t * method,
-                bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e)
+bitcoinrpc_call_prepare_(bitcoinrpc_cl_t *cl, CURL *curl, size_t n,
+                         bitcoinrpc_method_t **methods,
+                         struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                         struct bitcoinrpc_buf_ *sendbuf,
+                         struct bitcoinrpc_buf_ *recvbuf,
+                         bitcoinrpc_err_t *e)
 {
-  if (NULL == cl || NULL == method || NULL == resp)
-    return BITCOINRPCE_ARG;
+  double t0 = bitcoinrpc_call_now_();
+  BITCOINRPCEcode ecode;
 
-  return bitcoinrpc_calln(cl, 1, &method, &resp, e);
+  if (NULL == curl)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_BUG, "this should not happen; please report a bug");
+
+  if (bitcoinrpc_call_set_ids_(cl, n, methods) != BITCOINRPCE_OK)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "JSON error while setting the method id");
+
+  /*
+     Write the batch straight into sendbuf: each method keeps its request
+     serialised, so there is no JSON tree to build and dump.
+   */
+  bitcoinrpc_buf_clear_(sendbuf);
+  if (bitcoinrpc_buf_reserve_(sendbuf, 2 + n) != BITCOINRPCE_OK)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+
+  sendbuf->data[sendbuf->len++] = '[';
+  for (size_t i = 0; i < n; i++)
+    {
+      if (i > 0)
+        sendbuf->data[sendbuf->len++] = ',';
+      if (bitcoinrpc_method_append_post_(methods[i], sendbuf) != BITCOINRPCE_OK)
+        bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+    }
+  if (bitcoinrpc_buf_append_(sendbuf, "]", 1) != BITCOINRPCE_OK)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+
+  ecode = bitcoinrpc_call_arm_(cl, curl, n, curl_resp, sendbuf, recvbuf, e);
+  if (BITCOINRPCE_OK == ecode)
+    curl_resp->timings.prepare = bitcoinrpc_call_now_() - t0;
+
+  return ecode;
 }
 
 
+/*
+   Index of the methods of a batch by their ids, to match the responses
+   no matter in which order the server sends them back.  This is an open
+   addressing hash table of 2^k >= 2n slots.  A slot holds the position
+   of a method in the batch plus one, 0 if the slot is empty, or
+   BITCOINRPC_CALL_INDEX_TAKEN_ if the method has got its response already.
+ */
+#define BITCOINRPC_CALL_INDEX_TAKEN_ SIZE_MAX
+
+struct bitcoinrpc_call_index_ {
+  size_t mask;
+  size_t *slots;
+};
 
-BITCOINRPCEcode
-bitcoinrpc_calln(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
-                 bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
 
+/* FNV-1a */
+static size_t
+bitcoinrpc_call_hash_str_(const char *s)
 {
-  json_t *j = NULL;
-  json_t *jtmp = NULL;
-  char *data = NULL;
-  char url[BITCOINRPC_URL_MAXLEN];
-  char user[BITCOINRPC_PARAM_MAXLEN];
-  char pass[BITCOINRPC_PARAM_MAXLEN];
-  char credentials[2 * BITCOINRPC_PARAM_MAXLEN + 1];
-  struct bitcoinrpc_call_curl_resp_ curl_resp;
-  BITCOINRPCEcode ecode;
-  CURLcode curl_err;
-  char errbuf[BITCOINRPC_ERRMSG_MAXLEN];
-  char curl_errbuf[CURL_ERROR_SIZE];
+  uint64_t h = 14695981039346656037ULL;
 
-  if (NULL == cl || NULL == methods || NULL == resps)
-    return BITCOINRPCE_ARG;
+  while (*s != '\0')
+    {
+      h ^= (unsigned char)*s++;
+      h *= 1099511628211ULL;
+    }
+  return (size_t)h;
+}
 
-  /* make sure the error message will not be trash */
-  *(e->msg) = '\0';
 
-  j = json_array();
-  if (NULL == j)
-    bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "JSON error while creating a new json_array");
+/* The finaliser of splitmix64; the ids from the counter are consecutive */
+static size_t
+bitcoinrpc_call_hash_int_(json_int_t id)
+{
+  uint64_t h = (uint64_t)id;
+
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return (size_t)(h ^ (h >> 31));
+}
+
+
+/* An id is either a UUID string or an integer (BITCOINRPC_ID_COUNTER) */
+static size_t
+bitcoinrpc_call_hash_method_(bitcoinrpc_method_t *method)
+{
+  return (method->id != 0) ? bitcoinrpc_call_hash_int_(method->id)
+                           : bitcoinrpc_call_hash_str_(method->uuid_str);
+}
+
+
+static size_t
+bitcoinrpc_call_hash_id_(json_t *jid)
+{
+  if (json_is_integer(jid))
+    return bitcoinrpc_call_hash_int_(json_integer_value(jid));
+  if (json_is_string(jid))
+    return bitcoinrpc_call_hash_str_(json_string_value(jid));
+  return 0;
+}
+
+
+static int
+bitcoinrpc_call_match_id_(bitcoinrpc_method_t *method, json_t *jid)
+{
+  if (method->id != 0)
+    return json_is_integer(jid) && json_integer_value(jid) == method->id;
+
+  return json_is_string(jid)
+         && strcmp(json_string_value(jid), method->uuid_str) == 0;
+}
+
+
+static BITCOINRPCEcode
+bitcoinrpc_call_index_init_(struct bitcoinrpc_call_index_ *idx, size_t n,
+                            bitcoinrpc_method_t **methods,
+                            struct bitcoinrpc_buf_ *arena)
+{
+  size_t size = bitcoinrpc_call_index_size_(n);
+  size_t h;
+
+  idx->mask = size - 1;
+  idx->slots = bitcoinrpc_buf_alloc_(arena, size * sizeof *idx->slots);
+  if (NULL == idx->slots)
+    {
+      /* no room has been made by bitcoinrpc_call_prepare_(), so the arena is empty */
+      if (arena->len > 0
+          || bitcoinrpc_buf_reserve_(arena, size * sizeof *idx->slots) != BITCOINRPCE_OK)
+        return BITCOINRPCE_ALLOC;
+      idx->slots = bitcoinrpc_buf_alloc_(arena, size * sizeof *idx->slots);
+    }
+  memset(idx->slots, 0, size * sizeof *idx->slots);
 
   for (size_t i = 0; i < n; i++)
     {
-      jtmp = json_object();
-      if (NULL == jtmp)
-        bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "JSON error while creating a new json_object");
+      h = bitcoinrpc_call_hash_method_(methods[i]) & idx->mask;
+      while (idx->slots[h] != 0)
+        h = (h + 1) & idx->mask;
+      idx->slots[h] = i + 1;
+    }
 
-      json_object_set_new(jtmp, "jsonrpc", json_string("2.0"));
-      json_object_update(jtmp, bitcoinrpc_method_get_postjson_(methods[i]));
-      json_array_append_new(j, jtmp);
+  return BITCOINRPCE_OK;
+}
+
+
+/*
+   Find the position of the method with id jid in the batch and mark it
+   as taken.  Return n, if there is no such method or it has been taken already.
+ */
+static size_t
+bitcoinrpc_call_index_take_(struct bitcoinrpc_call_index_ *idx, size_t n,
+                            bitcoinrpc_method_t **methods, json_t *jid)
+{
+  size_t h = bitcoinrpc_call_hash_id_(jid) & idx->mask;
+  size_t i;
+
+  while ((i = idx->slots[h]) != 0)
+    {
+      if (i != BITCOINRPC_CALL_INDEX_TAKEN_
+          && bitcoinrpc_call_match_id_(methods[i - 1], jid))
+        {
+          idx->slots[h] = BITCOINRPC_CALL_INDEX_TAKEN_;
+          return i - 1;
+        }
+      h = (h + 1) & idx->mask;
     }
 
-  data = json_dumps(j, JSON_COMPACT);
-  if (NULL == data)
-    bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "JSON error while writing POST data");
+  return n;
+}
 
-  if (NULL == cl->curl)
-    bitcoinrpc_RETURN(e, BITCOINRPCE_BUG, "this should not happen; please report a bug");
 
-  curl_easy_setopt(cl->curl, CURLOPT_POSTFIELDSIZE, (long)strlen(data));
-  curl_easy_setopt(cl->curl, CURLOPT_POSTFIELDS, data);
-  curl_easy_setopt(cl->curl, CURLOPT_WRITEFUNCTION, bitcoinrpc_call_write_callback_);
-  curl_resp.called_before = 0;
-  curl_easy_setopt(cl->curl, CURLOPT_WRITEDATA, &curl_resp);
+/* Where the responses of bitcoinrpc_calln_stream() go, one by one */
+struct bitcoinrpc_call_sink_ {
+  bitcoinrpc_cl_t *cl;
+  size_t n;
+  bitcoinrpc_method_t **methods;
+  struct bitcoinrpc_call_index_ idx;
+  bitcoinrpc_stream_cb_t callback;
+  void *userdata;
+  bitcoinrpc_resp_t *resp;        /* lent to the callback, for every response */
+  size_t delivered;
+  int matched;
+};
 
-  ecode = bitcoinrpc_cl_get_url(cl, url);
 
-  if (ecode != BITCOINRPCE_OK)
-    bitcoinrpc_RETURN(e, BITCOINRPCE_BUG, "url malformed; please report a bug");
-  curl_easy_setopt(cl->curl, CURLOPT_URL, url);
+/* Match an element of the batch parsed just now and hand it to the callback */
+static BITCOINRPCEcode
+bitcoinrpc_call_sink_put_(struct bitcoinrpc_call_curl_resp_ *r, json_t *j, size_t bytes)
+{
+  struct bitcoinrpc_call_sink_ *sink = r->sink;
+  json_t *jid = json_object_get(j, "id");
+  size_t i;
 
-  bitcoinrpc_cl_get_user(cl, user);
-  bitcoinrpc_cl_get_pass(cl, pass);
-  snprintf(credentials, 2 * BITCOINRPC_PARAM_MAXLEN + 1,
-           "%s:%s", user, pass);
-  curl_easy_setopt(cl->curl, CURLOPT_USERPWD, credentials);
+  if (sink->n > 1)
+    i = bitcoinrpc_call_index_take_(&sink->idx, sink->n, sink->methods, jid);
+  else
+    i = bitcoinrpc_call_match_id_(sink->methods[0], jid) ? 0 : sink->n;
+  if (i == sink->n)
+    {
+      sink->matched = 0;
+      return BITCOINRPCE_OK;
+    }
+
+  bitcoinrpc_resp_reset(sink->resp);
+  bitcoinrpc_resp_set_json_(sink->resp, j);
+  uuid_copy(sink->resp->uuid, sink->methods[i]->uuid);
+  if (r->nsizes > 0)
+    sink->resp->bytes = bytes;
+  sink->delivered++;
+
+  if (sink->callback(sink->cl, i, sink->methods[i], sink->resp, sink->userdata) != 0)
+    {
+      r->e.code = BITCOINRPCE_ERR;
+      snprintf(r->e.msg, BITCOINRPC_ERRMSG_MAXLEN, "the call has been stopped by the callback");
+      return BITCOINRPCE_ERR;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+/* Timings of the transfer, as reported by curl */
+static void
+bitcoinrpc_call_curl_timings_(CURL *curl, bitcoinrpc_timings_t *t)
+{
+  curl_off_t us;
+
+  if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &us) == CURLE_OK)
+    t->namelookup = us * 1e-6;
+  if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &us) == CURLE_OK)
+    t->connect = us * 1e-6;
+  if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &us) == CURLE_OK)
+    t->pretransfer = us * 1e-6;
+  if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &us) == CURLE_OK)
+    t->starttransfer = us * 1e-6;
+  if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &us) == CURLE_OK)
+    t->total = us * 1e-6;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_call_finish_(CURL *curl, CURLcode curl_err, const char *curl_errbuf,
+                        struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                        size_t n, bitcoinrpc_method_t **methods,
+                        bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  bitcoinrpc_timings_t *t = &curl_resp->timings;
+  double t0;
+  json_t *j = NULL;
+  json_t *jtmp = NULL;
+  char errbuf[BITCOINRPC_ERRMSG_MAXLEN];
+  struct bitcoinrpc_call_index_ idx = { 0, NULL };
+  json_t *jid = NULL;
+  size_t i;
+  size_t raw_len = 0;
+  int matched = 1;
 
-  curl_easy_setopt(cl->curl, CURLOPT_USE_SSL, CURLUSESSL_TRY);
-  curl_easy_setopt(cl->curl, CURLOPT_ERRORBUFFER, curl_errbuf);
-  curl_err = curl_easy_perform(cl->curl);
+  /* the batch parsed by the write callback, if complete */
+  if (BITCOINRPC_CALL_STREAM_DONE == curl_resp->state)
+    j = curl_resp->batch;
+  else
+    json_decref(curl_resp->batch);
+  curl_resp->batch = NULL;
 
-  json_decref(j); /* no longer needed */
-  free(data);
+  /* The write callback failed to store the data (curl reports a write error) */
+  if (curl_resp->e.code != BITCOINRPCE_OK)
+    {
+      json_decref(j);
+      bitcoinrpc_buf_free_(curl_resp->buf);
+      bitcoinrpc_RETURN(e, curl_resp->e.code, curl_resp->e.msg);
+    }
 
   if (curl_err != CURLE_OK)
     {
+      json_decref(j);
       snprintf(errbuf, BITCOINRPC_ERRMSG_MAXLEN, "curl error: %s", curl_errbuf);
       bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, errbuf);
     }
 
-  /* Check if server returned valid json object */
-  if (curl_resp.e.code != BITCOINRPCE_OK)
+  if (NULL != curl)
+    {
+      long status = 0;
+
+      bitcoinrpc_call_curl_timings_(curl, t);
+
+      /* bitcoind -rpcworkqueue: the request has not been processed */
+      if (curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status) == CURLE_OK
+          && 503 == status)
+        {
+          json_decref(j);
+          bitcoinrpc_RETURN(e, BITCOINRPCE_BUSY, "the server is busy: work queue depth exceeded");
+        }
+    }
+
+  /* the elements have gone to the sink already */
+  if (NULL != curl_resp->sink && NULL != j)
     {
-      bitcoinrpc_RETURN(e, BITCOINRPCE_CON, curl_resp.e.msg);
+      json_decref(j);
+      bitcoinrpc_buf_shrink_(curl_resp->buf);
+      bitcoinrpc_buf_shrink_(&curl_resp->arena);
+      if (curl_resp->nelems != n)
+        bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "cannot parse data returned from the server");
+      if (!curl_resp->sink->matched)
+        bitcoinrpc_RETURN(e, BITCOINRPCE_CHECK,
+                          "at least one response id does not match corresponding post id");
+      bitcoinrpc_RETURN_OK;
     }
 
-  /* parse read data into json */
-  json_error_t jerr;
-  j = NULL;
-  j = json_loads(curl_resp.data, 0, &jerr);
+  /* not a batch (e.g. an error reported by the server), or a truncated one */
   if (NULL == j)
     {
-      snprintf(errbuf, BITCOINRPC_ERRMSG_MAXLEN,
-               "cannot parse JSON data from the server: %s", curl_resp.data);
-      bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, errbuf);
+      json_error_t jerr;
+      raw_len = curl_resp->buf->len;
+      t0 = bitcoinrpc_call_now_();
+      j = json_loadb(curl_resp->buf->data, curl_resp->buf->len, 0, &jerr);
+      t->parse += bitcoinrpc_call_now_() - t0;
+      if (NULL == j)
+        {
+          snprintf(errbuf, BITCOINRPC_ERRMSG_MAXLEN,
+                   "cannot parse JSON data from the server: %s",
+                   curl_resp->buf->len > 0 ? curl_resp->buf->data : "");
+          bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, errbuf);
+        }
     }
+  bitcoinrpc_buf_shrink_(curl_resp->buf);
 
-  for (size_t i = 0; i < n; i++)
+  if (!json_is_array(j) || json_array_size(j) != n)
+    {
+      json_decref(j);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "cannot parse data returned from the server");
+    }
+
+  t0 = bitcoinrpc_call_now_();
+
+  /* a single call needs no index */
+  if (n > 1 && bitcoinrpc_call_index_init_(&idx, n, methods, &curl_resp->arena)
+      != BITCOINRPCE_OK)
+    {
+      json_decref(j);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+    }
+
+  for (size_t k = 0; k < n; k++)
     {
-      jtmp = json_array_get(j, i);
-      if (NULL == jtmp)
+      jtmp = json_array_get(j, k);
+      jid = json_object_get(jtmp, "id");
+      if (n > 1)
+        i = bitcoinrpc_call_index_take_(&idx, n, methods, jid);
+      else
+        i = bitcoinrpc_call_match_id_(methods[0], jid) ? 0 : n;
+
+      if (i == n)
         {
-          bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "cannot parse data returned from the server");
+          matched = 0;
+          continue;
         }
       bitcoinrpc_resp_set_json_(resps[i], jtmp);
+      if (k < curl_resp->nsizes)
+        resps[i]->bytes = (0 == raw_len) ? curl_resp->sizes[k] : raw_len;
+      uuid_copy(resps[i]->uuid, methods[i]->uuid);
     }
 
-  bitcoinrpc_global_freefunc(curl_resp.data);
+  bitcoinrpc_buf_shrink_(&curl_resp->arena);
   json_decref(j);
 
-  for (size_t i = 0; i < n; i++)
+  t->match = bitcoinrpc_call_now_() - t0;
+  for (i = 0; i < n; i++)
+    resps[i]->timings = *t;
+
+  if (!matched)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_CHECK,
+                      "at least one response id does not match corresponding post id");
+
+  bitcoinrpc_RETURN_OK;
+}
+
+
+/* One of the two requests of a hedged call */
+struct bitcoinrpc_call_leg_ {
+  struct bitcoinrpc_node_ *node;
+  struct bitcoinrpc_cl_conn_ *conn;
+  double t0;
+  int running;
+  CURLcode curl_err;
+};
+
+
+/* Send the batch of the first leg to another node */
+static int
+bitcoinrpc_call_hedge_(bitcoinrpc_cl_t *cl, CURLM *curlm, size_t n,
+                       struct bitcoinrpc_call_leg_ *first,
+                       struct bitcoinrpc_call_leg_ *second)
+{
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+
+  second->node = bitcoinrpc_node_pick_(cl, first->node);
+  if (NULL == second->node)
+    return 0;
+
+  /* do not wait for a connection: the first request may still win */
+  conn = bitcoinrpc_cl_conn_tryget_(second->node->cl);
+  if (NULL == conn)
     {
-      if (bitcoinrpc_resp_check(resps[i], methods[i])
-          != BITCOINRPCE_OK)
-        bitcoinrpc_RETURN(e, BITCOINRPCE_CHECK,
-                          "at least one response id does not match corresponding post id");
+      bitcoinrpc_node_cancel_(cl, second->node, 0);
+      return 0;
     }
-  bitcoinrpc_RETURN_OK;
+
+  bitcoinrpc_buf_clear_(&conn->sendbuf);
+  if (bitcoinrpc_buf_append_(&conn->sendbuf, first->conn->sendbuf.data,
+                             first->conn->sendbuf.len) != BITCOINRPCE_OK
+      || bitcoinrpc_call_arm_(cl, conn->curl, n, &conn->curl_resp, &conn->sendbuf,
+                              &conn->recvbuf, NULL) != BITCOINRPCE_OK
+      || curl_multi_add_handle(curlm, conn->curl) != CURLM_OK)
+    {
+      bitcoinrpc_cl_conn_put_(second->node->cl, conn);
+      bitcoinrpc_node_cancel_(cl, second->node, 0);
+      return 0;
+    }
+
+  second->conn = conn;
+  second->t0 = bitcoinrpc_call_now_();
+  second->running = 1;
+  second->curl_err = CURLE_OK;
+
+  return 1;
+}
+
+
+/*
+   Drop the request which has lost (cancel it, if still running); its
+   transfer has been removed from the multi handle already.  The connection
+   is given back by the caller.
+ */
+static void
+bitcoinrpc_call_drop_leg_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_call_leg_ *leg)
+{
+  struct bitcoinrpc_cl_conn_ *conn = leg->conn;
+  double seconds = bitcoinrpc_call_now_() - leg->t0;
+
+  json_decref(conn->curl_resp.batch);
+  conn->curl_resp.batch = NULL;
+  bitcoinrpc_buf_shrink_(&conn->sendbuf);
+
+  if (leg->running)
+    bitcoinrpc_node_cancel_(cl, leg->node, seconds);
+  else
+    bitcoinrpc_node_done_(cl, leg->node, (CURLE_OK == leg->curl_err)
+                          ? BITCOINRPCE_OK : BITCOINRPCE_CURLE, seconds);
+}
+
+
+/*
+   A blocking call of methods which only read the state of the server.  If
+   it takes longer than delay, send it to another node as well: the first
+   response wins.  A request which has failed waits for the other one.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_calln_hedged_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                         bitcoinrpc_resp_t **resps, double delay, bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_call_leg_ leg[2];
+  struct bitcoinrpc_call_leg_ *end = NULL;
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+  size_t nlegs = 1;
+  int tried = 0;
+  int running, left, timeout_ms;
+  CURLM *curlm = NULL;
+  CURLMsg *msg = NULL;
+  BITCOINRPCEcode ecode;
+  double t0, now;
+
+  leg[0].node = bitcoinrpc_node_pick_(cl, NULL);
+  conn = bitcoinrpc_cl_conn_get_(leg[0].node->cl);
+  if (NULL == conn)
+    {
+      bitcoinrpc_node_done_(cl, leg[0].node, BITCOINRPCE_CURLE, 0);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, "cannot open a new connection");
+    }
+  leg[0].conn = conn;
+
+  t0 = bitcoinrpc_call_now_();
+  ecode = bitcoinrpc_call_prepare_(cl, conn->curl, n, methods, &conn->curl_resp,
+                                   &conn->sendbuf, &conn->recvbuf, e);
+  if (BITCOINRPCE_OK == ecode)
+    {
+      curlm = bitcoinrpc_cl_conn_multi_(conn);
+      if (NULL == curlm || curl_multi_add_handle(curlm, conn->curl) != CURLM_OK)
+        ecode = bitcoinrpc_err_set_(e, BITCOINRPCE_CURLE, "cannot start a transfer");
+    }
+  if (ecode != BITCOINRPCE_OK)
+    {
+      bitcoinrpc_cl_conn_put_(leg[0].node->cl, conn);
+      bitcoinrpc_node_done_(cl, leg[0].node, ecode, bitcoinrpc_call_now_() - t0);
+      bitcoinrpc_stats_record_(cl, n, methods, resps, ecode, bitcoinrpc_call_now_() - t0);
+      return ecode;
+    }
+  leg[0].t0 = t0;
+  leg[0].running = 1;
+  leg[0].curl_err = CURLE_OK;
+
+  while (NULL == end)
+    {
+      curl_multi_perform(curlm, &running);
+      while (NULL != (msg = curl_multi_info_read(curlm, &left)))
+        {
+          size_t k = (msg->easy_handle == leg[0].conn->curl) ? 0 : 1;
+
+          if (msg->msg != CURLMSG_DONE)
+            continue;
+          leg[k].running = 0;
+          leg[k].curl_err = msg->data.result;
+        }
+
+      for (size_t k = 0; k < nlegs && NULL == end; k++)
+        if (!leg[k].running && CURLE_OK == leg[k].curl_err)
+          end = &leg[k];
+      /* no response is coming: report the error of the first request */
+      if (NULL == end && !leg[0].running && (1 == nlegs || !leg[1].running))
+        end = &leg[0];
+      if (NULL != end)
+        break;
+
+      now = bitcoinrpc_call_now_();
+      if (!tried && now - t0 >= delay)
+        {
+          tried = 1;
+          if (bitcoinrpc_call_hedge_(cl, curlm, n, &leg[0], &leg[1]))
+            nlegs = 2;
+        }
+
+      timeout_ms = 1000;
+      if (!tried)
+        timeout_ms = (int)((t0 + delay - now) * 1000) + 1;
+      if (curl_multi_wait(curlm, NULL, 0, timeout_ms, NULL) != CURLM_OK)
+        {
+          end = &leg[0];
+          end->running = 0;
+          end->curl_err = CURLE_RECV_ERROR;
+          snprintf(end->conn->curl_errbuf, CURL_ERROR_SIZE, "cannot wait for the transfer");
+        }
+    }
+
+  /*
+     Stop both transfers before any connection goes back: the multi handle
+     is of the connection of the first request, which goes back last.
+   */
+  for (size_t k = 0; k < nlegs; k++)
+    curl_multi_remove_handle(curlm, leg[k].conn->curl);
+  for (size_t k = 0; k < nlegs; k++)
+    if (&leg[k] != end)
+      bitcoinrpc_call_drop_leg_(cl, &leg[k]);
+
+  conn = end->conn;
+  bitcoinrpc_buf_shrink_(&conn->sendbuf);
+  ecode = bitcoinrpc_call_finish_(conn->curl, end->curl_err, conn->curl_errbuf,
+                                  &conn->curl_resp, n, methods, resps, e);
+  if (2 == nlegs)
+    bitcoinrpc_cl_conn_put_(leg[1].node->cl, leg[1].conn);
+  bitcoinrpc_cl_conn_put_(leg[0].node->cl, leg[0].conn);
+
+  now = bitcoinrpc_call_now_();
+  bitcoinrpc_node_done_(cl, end->node, ecode, now - end->t0);
+  if (2 == nlegs)
+    bitcoinrpc_hedge_count_(cl->hedge, end == &leg[1] && BITCOINRPCE_OK == ecode);
+  bitcoinrpc_stats_record_(cl, n, methods, resps, ecode, now - t0);
+
+  return ecode;
+}
+
+
+/* A blocking call sent to a node */
+static BITCOINRPCEcode
+bitcoinrpc_calln_send_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                       bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_node_ *node = NULL;
+  bitcoinrpc_cl_t *ncl = cl;          /* whose connection is used */
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+  BITCOINRPCEcode ecode;
+  CURLcode curl_err;
+  double t0, delay;
+
+  delay = bitcoinrpc_hedge_delay_(cl, n, methods);
+  if (delay >= 0)
+    return bitcoinrpc_calln_hedged_(cl, n, methods, resps, delay, e);
+
+  node = bitcoinrpc_node_pick_(cl, NULL);
+  if (NULL != node)
+    ncl = node->cl;
+
+  conn = bitcoinrpc_cl_conn_get_(ncl);
+  if (NULL == conn)
+    {
+      bitcoinrpc_node_done_(cl, node, BITCOINRPCE_CURLE, 0);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, "cannot open a new connection");
+    }
+
+  t0 = bitcoinrpc_call_now_();
+  ecode = bitcoinrpc_call_prepare_(cl, conn->curl, n, methods, &conn->curl_resp,
+                                   &conn->sendbuf, &conn->recvbuf, e);
+  if (ecode != BITCOINRPCE_OK)
+    {
+      bitcoinrpc_cl_conn_put_(ncl, conn);
+      bitcoinrpc_node_done_(cl, node, ecode, bitcoinrpc_call_now_() - t0);
+      bitcoinrpc_stats_record_(cl, n, methods, resps, ecode, bitcoinrpc_call_now_() - t0);
+      return ecode;
+    }
+
+  curl_err = curl_easy_perform(conn->curl);
+  bitcoinrpc_buf_shrink_(&conn->sendbuf);
+
+  ecode = bitcoinrpc_call_finish_(conn->curl, curl_err, conn->curl_errbuf, &conn->curl_resp,
+                                  n, methods, resps, e);
+  bitcoinrpc_cl_conn_put_(ncl, conn);
+  bitcoinrpc_node_done_(cl, node, ecode, bitcoinrpc_call_now_() - t0);
+  bitcoinrpc_stats_record_(cl, n, methods, resps, ecode, bitcoinrpc_call_now_() - t0);
+
+  return ecode;
+}
+
+
+/*
+   A chunk of a batch split by the client, with the connection it is sent
+   with.  The connection is kept for the next chunks, until the call ends.
+   It is borrowed from the pool: in the thread-safe mode, every thread has
+   only one connection of its own.
+ */
+struct bitcoinrpc_call_chunk_ {
+  struct bitcoinrpc_node_ *node;
+  struct bitcoinrpc_cl_conn_ *conn;     /* NULL, if none leased yet */
+  size_t first;
+  size_t n;                             /* 0, if there is nothing to send */
+  size_t tries;
+  int running;
+  double t0;                            /* since the connection is leased */
+  double sent;
+  double resend_at;                     /* 0, unless refused by the server */
+  BITCOINRPCEcode code;                 /* of the last chunk */
+};
+
+
+/*
+   Send the chunk, within the limit of the calls in flight first, then
+   leasing a connection (if it has none), in the order of
+   bitcoinrpc_calln_().  If there is no room within the limit, or no
+   connection, wait only if told; otherwise return BITCOINRPCE_OK with the
+   chunk not running, to be sent later.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_call_chunk_send_(bitcoinrpc_cl_t *cl, CURLM **curlm,
+                            struct bitcoinrpc_call_chunk_ *c,
+                            bitcoinrpc_method_t **methods, int wait,
+                            bitcoinrpc_err_t *e)
+{
+  bitcoinrpc_cl_t *ncl = NULL;
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+  BITCOINRPCEcode ecode;
+
+  if (NULL != cl->limit && bitcoinrpc_limit_acquire_(cl->limit, wait) != BITCOINRPCE_OK)
+    {
+      if (!wait)
+        return BITCOINRPCE_OK;
+      bitcoinrpc_RETURN(e, BITCOINRPCE_ERR, "too many calls waiting for the server");
+    }
+
+  if (NULL == c->conn)
+    {
+      c->node = bitcoinrpc_node_pick_(cl, NULL);
+      ncl = (NULL != c->node) ? c->node->cl : cl;
+      c->conn = bitcoinrpc_cl_conn_borrow_(ncl, wait);
+      if (NULL == c->conn)
+        {
+          if (NULL != cl->limit)
+            bitcoinrpc_limit_release_(cl->limit, BITCOINRPCE_CURLE, 0);
+          if (!wait)
+            {
+              bitcoinrpc_node_cancel_(cl, c->node, 0);
+              return BITCOINRPCE_OK;
+            }
+          bitcoinrpc_node_done_(cl, c->node, BITCOINRPCE_CURLE, 0);
+          bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, "cannot open a new connection");
+        }
+      c->t0 = bitcoinrpc_call_now_();
+      c->code = BITCOINRPCE_OK;
+    }
+  conn = c->conn;
+
+  c->sent = bitcoinrpc_call_now_();
+  ecode = bitcoinrpc_call_prepare_(cl, conn->curl, c->n, methods + c->first,
+                                   &conn->curl_resp, &conn->sendbuf, &conn->recvbuf, e);
+  if (BITCOINRPCE_OK == ecode)
+    {
+      /* the multi handle of the first connection, leased until the call ends */
+      if (NULL == *curlm)
+        *curlm = bitcoinrpc_cl_conn_multi_(conn);
+      if (NULL == *curlm || curl_multi_add_handle(*curlm, conn->curl) != CURLM_OK)
+        ecode = bitcoinrpc_err_set_(e, BITCOINRPCE_CURLE, "cannot start a transfer");
+    }
+  if (ecode != BITCOINRPCE_OK)
+    {
+      if (NULL != cl->limit)
+        bitcoinrpc_limit_release_(cl->limit, ecode, 0);
+      c->code = ecode;
+      return ecode;
+    }
+  c->running = 1;
+
+  bitcoinrpc_RETURN_OK;
+}
+
+
+/*
+   The transfer of the chunk has ended.  A chunk refused by the server is
+   kept to be sent again after a while (as bitcoinrpc_calln_() does).
+ */
+static BITCOINRPCEcode
+bitcoinrpc_call_chunk_done_(bitcoinrpc_cl_t *cl, CURLM *curlm,
+                            struct bitcoinrpc_call_chunk_ *c, CURLcode curl_err,
+                            bitcoinrpc_method_t **methods, bitcoinrpc_resp_t **resps,
+                            bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_cl_conn_ *conn = c->conn;
+  BITCOINRPCEcode ecode;
+  double seconds;
+
+  curl_multi_remove_handle(curlm, conn->curl);
+  bitcoinrpc_buf_shrink_(&conn->sendbuf);
+  ecode = bitcoinrpc_call_finish_(conn->curl, curl_err, conn->curl_errbuf, &conn->curl_resp,
+                                  c->n, methods + c->first, resps + c->first, e);
+  seconds = bitcoinrpc_call_now_() - c->sent;
+  if (NULL != cl->limit)
+    bitcoinrpc_limit_release_(cl->limit, ecode, seconds);
+  bitcoinrpc_stats_record_(cl, c->n, methods + c->first, resps + c->first, ecode, seconds);
+  c->running = 0;
+  c->code = ecode;
+
+  if (BITCOINRPCE_BUSY == ecode && NULL != cl->limit && c->tries < BITCOINRPC_LIMIT_RETRIES_)
+    {
+      c->resend_at = bitcoinrpc_call_now_() + bitcoinrpc_call_backoff_(c->tries);
+      c->tries++;
+      return BITCOINRPCE_OK;
+    }
+  c->n = 0;
+
+  return ecode;
+}
+
+
+/*
+   Give back the connections of the chunks, none of them running.  The one
+   owning the multi handle goes last.
+ */
+static void
+bitcoinrpc_call_chunks_return_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_call_chunk_ *chunks,
+                               size_t nslots, CURLM *curlm)
+{
+  struct bitcoinrpc_call_chunk_ *c = NULL;
+  struct bitcoinrpc_call_chunk_ *owner = NULL;
+  double now = bitcoinrpc_call_now_();
+
+  for (size_t k = 0; k < nslots; k++)
+    {
+      c = &chunks[k];
+      if (NULL == c->conn)
+        continue;
+      if (NULL != curlm && c->conn->curlm == curlm)
+        {
+          owner = c;
+          continue;
+        }
+      bitcoinrpc_cl_conn_return_((NULL != c->node) ? c->node->cl : cl, c->conn);
+      bitcoinrpc_node_done_(cl, c->node, c->code, now - c->t0);
+      c->conn = NULL;
+    }
+  if (NULL != owner)
+    {
+      bitcoinrpc_cl_conn_return_((NULL != owner->node) ? owner->node->cl : cl, owner->conn);
+      bitcoinrpc_node_done_(cl, owner->node, owner->code, now - owner->t0);
+      owner->conn = NULL;
+    }
+}
+
+
+/*
+   A blocking call of a batch split into chunks, up to cl->chunk_inflight
+   of them in flight.  Every chunk fills in its own part of resps, so the
+   responses stay in order.  After an error, no more chunks are sent; the
+   first error is reported.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_calln_chunked_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                          bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_call_chunk_ *chunks = NULL;
+  struct bitcoinrpc_call_chunk_ *c = NULL;
+  size_t size = cl->chunk_size;
+  size_t nslots = cl->chunk_inflight;
+  size_t next = 0, running = 0, ended;
+  CURLM *curlm = NULL;
+  CURLMsg *msg = NULL;
+  bitcoinrpc_err_t first, ce;
+  BITCOINRPCEcode ecode = BITCOINRPCE_OK;
+  BITCOINRPCEcode ccode;
+  int still, left;
+  double now;
+
+  if (nslots > (n + size - 1) / size)
+    nslots = (n + size - 1) / size;
+  chunks = bitcoinrpc_global_allocfunc(nslots * sizeof *chunks);
+  if (NULL == chunks)
+    bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+  memset(chunks, 0, nslots * sizeof *chunks);
+  first.msg[0] = '\0';
+
+  for (;;)
+    {
+      /* nothing in flight: hold no connection while waiting, on the limit or the pool */
+      if (0 == running)
+        {
+          bitcoinrpc_call_chunks_return_(cl, chunks, nslots, curlm);
+          curlm = NULL;
+        }
+
+      /* send the chunks to be sent again, then the next ones, while there is room */
+      for (size_t k = 0; k < nslots && BITCOINRPCE_OK == ecode; k++)
+        {
+          c = &chunks[k];
+          if (c->running)
+            continue;
+          if (0 == c->n)
+            {
+              if (next == n)
+                continue;
+              c->first = next;
+              c->n = (n - next < size) ? n - next : size;
+              c->tries = 0;
+              next += c->n;
+            }
+          /* refused: sent again after a while, if there is nothing else to wait for */
+          if (c->resend_at > 0)
+            {
+              now = bitcoinrpc_call_now_();
+              if (now < c->resend_at && running > 0)
+                continue;
+              if (now < c->resend_at)
+                bitcoinrpc_call_sleep_(c->resend_at - now);
+              c->resend_at = 0;
+            }
+          ecode = bitcoinrpc_call_chunk_send_(cl, &curlm, c, methods, 0 == running, &first);
+          if (!c->running)
+            break;
+          running++;
+        }
+      if (0 == running)
+        break;
+
+      ended = 0;
+      curl_multi_perform(curlm, &still);
+      while (NULL != (msg = curl_multi_info_read(curlm, &left)))
+        {
+          if (msg->msg != CURLMSG_DONE)
+            continue;
+          for (c = chunks; c < chunks + nslots; c++)
+            if (NULL != c->conn && c->conn->curl == msg->easy_handle)
+              break;
+          if (c == chunks + nslots)
+            continue;
+          ccode = bitcoinrpc_call_chunk_done_(cl, curlm, c, msg->data.result,
+                                              methods, resps, &ce);
+          if (ccode != BITCOINRPCE_OK && BITCOINRPCE_OK == ecode)
+            {
+              ecode = ccode;
+              first = ce;
+            }
+          running--;
+          ended++;
+        }
+
+      if (0 == ended && curl_multi_wait(curlm, NULL, 0, 1000, NULL) != CURLM_OK)
+        {
+          if (BITCOINRPCE_OK == ecode)
+            ecode = bitcoinrpc_err_set_(&first, BITCOINRPCE_CURLE, "cannot wait for the transfers");
+          break;
+        }
+    }
+
+  /* after an error: stop the transfers still running, before any connection goes back */
+  for (size_t k = 0; k < nslots; k++)
+    {
+      c = &chunks[k];
+      if (!c->running)
+        continue;
+      curl_multi_remove_handle(curlm, c->conn->curl);
+      json_decref(c->conn->curl_resp.batch);
+      c->conn->curl_resp.batch = NULL;
+      if (NULL != cl->limit)
+        bitcoinrpc_limit_release_(cl->limit, BITCOINRPCE_CURLE, 0);
+    }
+
+  bitcoinrpc_call_chunks_return_(cl, chunks, nslots, curlm);
+  bitcoinrpc_global_freefunc(chunks);
+
+  if (ecode != BITCOINRPCE_OK)
+    bitcoinrpc_RETURN(e, ecode, first.msg);
+
+  bitcoinrpc_RETURN_OK;
+}
+
+
+/*
+   A blocking call, in the allocation scope of the client, within the limit
+   of the calls in flight (if enabled)
+ */
+static BITCOINRPCEcode
+bitcoinrpc_calln_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                  bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  BITCOINRPCEcode ecode;
+  double t0;
+
+  if (cl->chunk_size > 0 && n > cl->chunk_size)
+    return bitcoinrpc_calln_chunked_(cl, n, methods, resps, e);
+
+  if (NULL == cl->limit)
+    return bitcoinrpc_calln_send_(cl, n, methods, resps, e);
+
+  for (size_t k = 0; ; k++)
+    {
+      if (bitcoinrpc_limit_acquire_(cl->limit, 1) != BITCOINRPCE_OK)
+        bitcoinrpc_RETURN(e, BITCOINRPCE_ERR, "too many calls waiting for the server");
+
+      t0 = bitcoinrpc_call_now_();
+      ecode = bitcoinrpc_calln_send_(cl, n, methods, resps, e);
+      bitcoinrpc_limit_release_(cl->limit, ecode, bitcoinrpc_call_now_() - t0);
+
+      /* refused, not processed: safe to send again */
+      if (ecode != BITCOINRPCE_BUSY || k == BITCOINRPC_LIMIT_RETRIES_)
+        return ecode;
+      bitcoinrpc_call_sleep_(bitcoinrpc_call_backoff_(k));
+    }
+}
+
+
+/* A blocking call sent to a node, with the responses going to the sink */
+static BITCOINRPCEcode
+bitcoinrpc_calln_stream_send_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_call_sink_ *sink,
+                              bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_node_ *node = NULL;
+  bitcoinrpc_cl_t *ncl = cl;
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+  BITCOINRPCEcode ecode;
+  CURLcode curl_err;
+  double t0;
+
+  node = bitcoinrpc_node_pick_(cl, NULL);
+  if (NULL != node)
+    ncl = node->cl;
+
+  conn = bitcoinrpc_cl_conn_get_(ncl);
+  if (NULL == conn)
+    {
+      bitcoinrpc_node_done_(cl, node, BITCOINRPCE_CURLE, 0);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_CURLE, "cannot open a new connection");
+    }
+
+  t0 = bitcoinrpc_call_now_();
+  ecode = bitcoinrpc_call_prepare_(cl, conn->curl, sink->n, sink->methods, &conn->curl_resp,
+                                   &conn->sendbuf, &conn->recvbuf, e);
+  if (BITCOINRPCE_OK == ecode && sink->n > 1
+      && bitcoinrpc_call_index_init_(&sink->idx, sink->n, sink->methods,
+                                     &conn->curl_resp.arena) != BITCOINRPCE_OK)
+    {
+      ecode = BITCOINRPCE_ALLOC;
+      bitcoinrpc_err_set_(e, ecode, "cannot allocate more memory");
+    }
+  if (ecode != BITCOINRPCE_OK)
+    {
+      bitcoinrpc_cl_conn_put_(ncl, conn);
+      bitcoinrpc_node_done_(cl, node, ecode, bitcoinrpc_call_now_() - t0);
+      bitcoinrpc_stats_record_(cl, sink->n, sink->methods, NULL, ecode,
+                               bitcoinrpc_call_now_() - t0);
+      return ecode;
+    }
+
+  conn->curl_resp.sink = sink;
+  curl_err = curl_easy_perform(conn->curl);
+  bitcoinrpc_buf_shrink_(&conn->sendbuf);
+
+  ecode = bitcoinrpc_call_finish_(conn->curl, curl_err, conn->curl_errbuf, &conn->curl_resp,
+                                  sink->n, sink->methods, NULL, e);
+  conn->curl_resp.sink = NULL;
+  bitcoinrpc_cl_conn_put_(ncl, conn);
+  bitcoinrpc_node_done_(cl, node, ecode, bitcoinrpc_call_now_() - t0);
+  bitcoinrpc_stats_record_(cl, sink->n, sink->methods, NULL, ecode,
+                           bitcoinrpc_call_now_() - t0);
+
+  return ecode;
+}
+
+
+/*
+   Give the method a response made of the result and error of another one
+   (cached, or got by another thread), as if it came from the server: with
+   the id of the method (a new one).
+ */
+static BITCOINRPCEcode
+bitcoinrpc_call_respond_(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                         bitcoinrpc_resp_t *resp, json_t *result, json_t *error)
+{
+  json_t *j = NULL;
+  json_t *jid = NULL;
+
+  if (bitcoinrpc_call_set_ids_(cl, 1, &method) != BITCOINRPCE_OK)
+    return BITCOINRPCE_JSON;
+  if (0 != method->id)
+    jid = json_integer(method->id);
+  else
+    jid = json_string(method->uuid_str);
+
+  j = json_pack("{s:O?, s:O?, s:o}", "result", result, "error", error, "id", jid);
+  if (NULL == j)
+    return BITCOINRPCE_JSON;
+  bitcoinrpc_resp_set_json_(resp, j);
+  json_decref(j);
+  uuid_copy(resp->uuid, method->uuid);
+
+  return BITCOINRPCE_OK;
+}
+
+
+/* Batches up to this size keep their misses on the stack */
+#define BITCOINRPC_CALL_MISSES_ 16
+
+/*
+   A blocking call with the cache enabled: serve the hits, send the misses
+   to the server (if any) and cache their results.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_calln_cached_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                         bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  bitcoinrpc_method_t *mbuf[BITCOINRPC_CALL_MISSES_];
+  bitcoinrpc_resp_t *rbuf[BITCOINRPC_CALL_MISSES_];
+  bitcoinrpc_method_t **mmiss = mbuf;
+  bitcoinrpc_resp_t **rmiss = rbuf;
+  BITCOINRPCEcode ecode = BITCOINRPCE_OK;
+  json_t *result = NULL;
+  size_t nmiss = 0;
+
+  if (n > BITCOINRPC_CALL_MISSES_)
+    {
+      mmiss = bitcoinrpc_global_allocfunc(n * (sizeof *mmiss + sizeof *rmiss));
+      if (NULL == mmiss)
+        bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+      rmiss = (bitcoinrpc_resp_t **)(mmiss + n);
+    }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      result = NULL;
+      if (bitcoinrpc_cache_method_(methods[i]))
+        result = bitcoinrpc_cache_get_(cl->cache, methods[i]);
+      if (NULL == result)
+        {
+          mmiss[nmiss] = methods[i];
+          rmiss[nmiss++] = resps[i];
+          continue;
+        }
+      ecode = bitcoinrpc_call_respond_(cl, methods[i], resps[i], result, NULL);
+      json_decref(result);
+      resps[i]->bytes = 0;
+      memset(&resps[i]->timings, 0, sizeof resps[i]->timings);
+      if (ecode != BITCOINRPCE_OK)
+        break;
+    }
+
+  if (ecode != BITCOINRPCE_OK)
+    {
+      if (mmiss != mbuf)
+        bitcoinrpc_global_freefunc(mmiss);
+      bitcoinrpc_RETURN(e, ecode, "JSON error while serving a cached result");
+    }
+
+  if (nmiss > 0)
+    {
+      ecode = bitcoinrpc_calln_(cl, nmiss, mmiss, rmiss, e);
+      if (BITCOINRPCE_OK == ecode)
+        for (size_t k = 0; k < nmiss; k++)
+          if (bitcoinrpc_cache_method_(mmiss[k]))
+            bitcoinrpc_cache_put_(cl->cache, mmiss[k], rmiss[k]->json);
+    }
+
+  if (mmiss != mbuf)
+    bitcoinrpc_global_freefunc(mmiss);
+
+  if (0 == nmiss)
+    bitcoinrpc_RETURN_OK;
+
+  return ecode;
+}
+
+
+/* A blocking call, with the cache if enabled */
+static BITCOINRPCEcode
+bitcoinrpc_calln_any_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                      bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+{
+  if (NULL != cl->cache)
+    return bitcoinrpc_calln_cached_(cl, n, methods, resps, e);
+
+  return bitcoinrpc_calln_(cl, n, methods, resps, e);
+}
+
+
+/*
+   A blocking call of one method in the single-flight mode: either make it
+   and share the response, or wait for the same call made by another thread.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_call_flight_(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                        bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e)
+{
+  struct bitcoinrpc_flight_call_ *call = NULL;
+  bitcoinrpc_err_t e_own;
+  BITCOINRPCEcode ecode;
+  json_t *j = NULL;
+  int leader = 0;
+
+  if (NULL == e)
+    {
+      e_own.msg[0] = '\0';
+      e = &e_own;
+    }
+
+  call = bitcoinrpc_flight_join_(cl->flight, method, &leader);
+  if (NULL == call)
+    return bitcoinrpc_calln_any_(cl, 1, &method, &resp, e);
+
+  if (leader)
+    {
+      ecode = bitcoinrpc_calln_any_(cl, 1, &method, &resp, e);
+      e->code = ecode;
+      bitcoinrpc_flight_land_(cl->flight, call, e, resp);
+      return ecode;
+    }
+
+  ecode = bitcoinrpc_flight_wait_(cl->flight, call, e, resp, &j);
+  if (NULL != j)
+    {
+      if (bitcoinrpc_call_respond_(cl, method, resp, json_object_get(j, "result"),
+                                   json_object_get(j, "error")) != BITCOINRPCE_OK)
+        {
+          json_decref(j);
+          bitcoinrpc_RETURN(e, BITCOINRPCE_JSON, "JSON error while sharing a response");
+        }
+      json_decref(j);
+    }
+
+  return ecode;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_call(bitcoinrpc_cl_t * cl, bitcoinrpc_method_t * method,
+                bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e)
+{
+  if (NULL == cl || NULL == method || NULL == resp)
+    return BITCOINRPCE_ARG;
+
+  return bitcoinrpc_calln(cl, 1, &method, &resp, e);
+}
+
+
+
+BITCOINRPCEcode
+bitcoinrpc_calln(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                 bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e)
+
+{
+  BITCOINRPCEcode ecode;
+  struct bitcoinrpc_global_scope_ scope;
+  struct bitcoinrpc_global_tracker_ tracker;
+
+  if (NULL == cl || NULL == methods || NULL == resps)
+    return BITCOINRPCE_ARG;
+
+  /* make sure the error message will not be trash */
+  if (NULL != e)
+    *(e->msg) = '\0';
+
+  /* count what the call allocates, including a new connection */
+  memset(&tracker, 0, sizeof tracker);
+  tracker.limit = cl->call_memlimit;
+  bitcoinrpc_global_enter_(&scope, cl->account, &tracker);
+  if (NULL != cl->flight && 1 == n)
+    ecode = bitcoinrpc_call_flight_(cl, methods[0], resps[0], e);
+  else
+    ecode = bitcoinrpc_calln_any_(cl, n, methods, resps, e);
+  bitcoinrpc_global_leave_(&scope);
+
+  if (bitcoinrpc_global_accounting_)
+    for (size_t i = 0; i < n; i++)
+      resps[i]->memstats = tracker.m;
+
+  return ecode;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_calln_stream(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                        bitcoinrpc_stream_cb_t callback, void *userdata,
+                        bitcoinrpc_err_t *e)
+{
+  BITCOINRPCEcode ecode = BITCOINRPCE_OK;
+  struct bitcoinrpc_global_scope_ scope;
+  struct bitcoinrpc_global_tracker_ tracker;
+  struct bitcoinrpc_call_sink_ sink;
+  double t0;
+
+  if (NULL == cl || 0 == n || NULL == methods || NULL == callback)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != e)
+    *(e->msg) = '\0';
+
+  memset(&tracker, 0, sizeof tracker);
+  tracker.limit = cl->call_memlimit;
+  bitcoinrpc_global_enter_(&scope, cl->account, &tracker);
+
+  sink.cl = cl;
+  sink.n = n;
+  sink.methods = methods;
+  sink.callback = callback;
+  sink.userdata = userdata;
+  sink.resp = bitcoinrpc_resp_init();
+  if (NULL == sink.resp)
+    {
+      bitcoinrpc_global_leave_(&scope);
+      bitcoinrpc_RETURN(e, BITCOINRPCE_ALLOC, "cannot allocate more memory");
+    }
+
+  for (size_t k = 0; ; k++)
+    {
+      sink.delivered = 0;
+      sink.matched = 1;
+
+      if (NULL == cl->limit)
+        {
+          ecode = bitcoinrpc_calln_stream_send_(cl, &sink, e);
+          break;
+        }
+
+      if (bitcoinrpc_limit_acquire_(cl->limit, 1) != BITCOINRPCE_OK)
+        {
+          ecode = BITCOINRPCE_ERR;
+          bitcoinrpc_err_set_(e, ecode, "too many calls waiting for the server");
+          break;
+        }
+      t0 = bitcoinrpc_call_now_();
+      ecode = bitcoinrpc_calln_stream_send_(cl, &sink, e);
+      bitcoinrpc_limit_release_(cl->limit, ecode, bitcoinrpc_call_now_() - t0);
+
+      /* the callback must not see a response twice */
+      if (ecode != BITCOINRPCE_BUSY || sink.delivered > 0 || k == BITCOINRPC_LIMIT_RETRIES_)
+        break;
+      bitcoinrpc_call_sleep_(bitcoinrpc_call_backoff_(k));
+    }
+
+  bitcoinrpc_resp_free(sink.resp);
+  bitcoinrpc_global_leave_(&scope);
+
+  return ecode;
 }
@@ -78,7 +78,8 @@ typedef enum {
   BITCOINRPCE_CURLE,              /* libcurl returned some error */
   BITCOINRPCE_ERR,                /* unspecific error */
   BITCOINRPCE_JSON,               /* error parsing json data */
-  BITCOINRPCE_SERV                /* Bitcoin server returned error */
+  BITCOINRPCE_SERV,               /* Bitcoin server returned error */
+  BITCOINRPCE_BUSY                /* server too busy, call not processed */
 } BITCOINRPCEcode;
 
 
@@ -185,6 +186,12 @@ typedef enum {
   BITCOINRPC_METHOD_WALLETPASSPHRASECHANGE     /* walletpassphrasechange */
 } BITCOINRPC_METHOD;
 
+/* How the requests are identified (see: bitcoinrpc_cl_set_idmode()) */
+typedef enum {
+  BITCOINRPC_ID_UUID,            /* a random UUID per method (the default) */
+  BITCOINRPC_ID_COUNTER          /* an integer counted by the client */
+} BITCOINRPC_ID;
+
 /* ---------------- bitcoinrpc_err --------------------- */
 struct bitcoinrpc_err {
   BITCOINRPCEcode code;
@@ -226,6 +233,36 @@ bitcoinrpc_global_set_allocfunc(void * (*const f)(size_t size));
 BITCOINRPCEcode
 bitcoinrpc_global_set_freefunc(void(*const f) (void *ptr));
 
+/*
+   Memory allocated by the library: in total, by a client, or by a call.
+   in_use and peak of a call are counted from its start (memory freed
+   during the call may make in_use negative).
+ */
+struct bitcoinrpc_memstats {
+  unsigned long long allocs;    /* number of allocations */
+  unsigned long long bytes;     /* allocated in total */
+  long long in_use;             /* bytes allocated and not freed yet */
+  long long peak;               /* the highest in_use */
+};
+
+typedef
+struct bitcoinrpc_memstats
+bitcoinrpc_memstats_t;
+
+/*
+   Count the memory allocated by the library (on top of the allocating
+   function set by the user).  If jansson is not 0, jansson is set to
+   allocate through the library as well, with json_set_alloc_funcs().
+   Call this right after bitcoinrpc_global_init(), before any object
+   (or, with jansson, any JSON value) is created.
+ */
+BITCOINRPCEcode
+bitcoinrpc_global_enable_accounting(int jansson);
+
+/* Get the memory allocated by the library; BITCOINRPCE_ERR if not counted */
+BITCOINRPCEcode
+bitcoinrpc_global_get_memstats(bitcoinrpc_memstats_t *memstats);
+
 
 /* -------------bitcoinrpc_cl --------------------- */
 struct bitcoinrpc_cl;
@@ -252,6 +289,30 @@ bitcoinrpc_cl_t*
 bitcoinrpc_cl_init_params(const char* user, const char* pass,
                           const char* addr, const unsigned int port);
 
+/*
+   Same as bitcoinrpc_cl_init_params(), but the client keeps a pool of at most
+   max_conns (> 0) persistent connections.  Each blocking call leases an idle
+   connection from the pool (or waits for one), so the client can be shared
+   by up to max_conns threads calling the server at the same time.
+   A client initialised with bitcoinrpc_cl_init_params() has a pool of one.
+ */
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_pool(const char* user, const char* pass,
+                        const char* addr, const unsigned int port,
+                        size_t max_conns);
+
+/*
+   Same as bitcoinrpc_cl_init_params(), but the client is thread-safe:
+   any number of threads can make blocking calls through it at the same
+   time, without external locking.  Each thread lazily gets its own
+   connection; all of them share the DNS and connection caches.
+   Asynchronous calls still have to be driven from one thread at a time.
+   Free the client only after the other threads have stopped using it.
+ */
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_threadsafe(const char* user, const char* pass,
+                              const char* addr, const unsigned int port);
+
 /* Free the handle. */
 BITCOINRPCEcode
 bitcoinrpc_cl_free(bitcoinrpc_cl_t *cl);
@@ -279,6 +340,42 @@ bitcoinrpc_cl_get_port(bitcoinrpc_cl_t *cl, unsigned int *bufi);
 BITCOINRPCEcode
 bitcoinrpc_cl_get_url(bitcoinrpc_cl_t *cl, char *buf);
 
+/*
+   Set how the client identifies its requests.  With BITCOINRPC_ID_UUID
+   (the default), each method gets a random UUID (a JSON string), which
+   stays the same until the method is changed.  With BITCOINRPC_ID_COUNTER,
+   the method gets a new id on every call: the next value of a 64-bit counter
+   of the client (a JSON integer), which is cheaper to make and to match.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_idmode(bitcoinrpc_cl_t *cl, BITCOINRPC_ID idmode);
+
+/*
+   Get the memory allocated by the library on behalf of the client (its
+   connections and buffers, and the calls made with it).  Return
+   BITCOINRPCE_ERR, if the allocations were not counted when the client
+   was created (see: bitcoinrpc_global_enable_accounting()).
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_get_memstats(bitcoinrpc_cl_t *cl, bitcoinrpc_memstats_t *memstats);
+
+/*
+   Make a blocking call fail with BITCOINRPCE_ALLOC, if the memory it holds
+   would exceed limit bytes (0 means no limit, the default).  The allocations
+   have to be counted (see: bitcoinrpc_global_enable_accounting()).
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_call_memlimit(bitcoinrpc_cl_t *cl, size_t limit);
+
+/*
+   Split the blocking calls of more than chunk methods into batches of chunk
+   methods, and send up to inflight of them at once, over as many connections
+   (and nodes) as there are.  The responses are put in the order of the
+   methods, as usual.  0 chunk means no split, the default.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_chunking(bitcoinrpc_cl_t *cl, size_t chunk, size_t inflight);
+
 /* ------------- bitcoinrpc_method --------------------- */
 struct bitcoinrpc_method;
 
@@ -315,6 +412,27 @@ bitcoinrpc_method_free(bitcoinrpc_method_t *method);
 BITCOINRPCEcode
 bitcoinrpc_method_set_params(bitcoinrpc_method_t *method, json_t *params);
 
+/*
+   Set the i-th parameter in place, without copying the others (the params
+   must be an array, or NULL).  The parameter may be replaced (even with
+   one of another type) or, if i is the number of params, appended.
+ */
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_int(bitcoinrpc_method_t *method, size_t i,
+                                json_int_t value);
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_real(bitcoinrpc_method_t *method, size_t i,
+                                 double value);
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_str(bitcoinrpc_method_t *method, size_t i,
+                                const char *value);
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_bool(bitcoinrpc_method_t *method, size_t i,
+                                 int value);
+
 /* Get a deepcopy of the method's parameters and store it in params */
 BITCOINRPCEcode
 bitcoinrpc_method_get_params(bitcoinrpc_method_t *method, json_t **params);
@@ -329,6 +447,14 @@ bitcoinrpc_method_get_params(bitcoinrpc_method_t *method, json_t **params);
 BITCOINRPCEcode
 bitcoinrpc_method_set_nonstandard(bitcoinrpc_method_t *method, char *name);
 
+/*
+   Make the method as new: the same as freeing it and initialising it again
+   with m and params (copied), but its memory is kept for reuse.
+ */
+BITCOINRPCEcode
+bitcoinrpc_method_reset(bitcoinrpc_method_t *method, const BITCOINRPC_METHOD m,
+                        json_t * const params);
+
 /* ------------- bitcoinrpc_resp --------------------- */
 struct bitcoinrpc_resp;
 
@@ -336,12 +462,32 @@ typedef
 struct bitcoinrpc_resp
 bitcoinrpc_resp_t;
 
+/* Where the time of a call has gone, in seconds */
+struct bitcoinrpc_timings {
+  double prepare;         /* setting ids and serialising the batch */
+  double namelookup;      /* as reported by curl, from the start */
+  double connect;         /* of the transfer; connect is 0, if */
+  double pretransfer;     /* the connection has been reused */
+  double starttransfer;   /* the first byte of the response (server time) */
+  double total;           /* the whole transfer */
+  double parse;           /* parsing JSON, mostly while the data arrive */
+  double match;           /* matching the responses with the methods */
+};
+
+typedef
+struct bitcoinrpc_timings
+bitcoinrpc_timings_t;
+
 bitcoinrpc_resp_t *
 bitcoinrpc_resp_init(void);
 
 BITCOINRPCEcode
 bitcoinrpc_resp_free(bitcoinrpc_resp_t *resp);
 
+/* Forget the response, to use resp for another call */
+BITCOINRPCEcode
+bitcoinrpc_resp_reset(bitcoinrpc_resp_t *resp);
+
 /*
    Get a deepcopy of the json object representing the response
    from the server or NULL in case of error.
@@ -349,6 +495,28 @@ bitcoinrpc_resp_free(bitcoinrpc_resp_t *resp);
 json_t *
 bitcoinrpc_resp_get(bitcoinrpc_resp_t *resp);
 
+/*
+   Get the json object representing the response without copying it.
+   It is owned by resp: valid until resp is freed or used for another call.
+ */
+json_t *
+bitcoinrpc_resp_get_borrowed(bitcoinrpc_resp_t *resp);
+
+/*
+   Get the timings of the call which stored the response (the same for all
+   the responses of a batch).
+ */
+BITCOINRPCEcode
+bitcoinrpc_resp_get_timings(bitcoinrpc_resp_t *resp, bitcoinrpc_timings_t *timings);
+
+/*
+   Get the memory allocated by the library during the blocking call which
+   stored the response (the same for all the responses of a batch).
+   All zero, if the allocations are not counted.
+ */
+BITCOINRPCEcode
+bitcoinrpc_resp_get_memstats(bitcoinrpc_resp_t *resp, bitcoinrpc_memstats_t *memstats);
+
 /*
    Check if the resp comes as a result of calling method.
    Returns BITCOINRPCE_CHECK, if not. This check is already performed by
@@ -358,6 +526,51 @@ BITCOINRPCEcode
 bitcoinrpc_resp_check(bitcoinrpc_resp_t *resp, bitcoinrpc_method_t *method);
 
 
+/* ------------- bitcoinrpc_objpool --------------------- */
+/*
+   A pool of methods and responses: the objects put back into the pool are
+   reset and handed out again, so a loop which gets and puts them allocates
+   nothing (but copies of the params).  A pool may be shared by many threads.
+ */
+struct bitcoinrpc_objpool;
+
+typedef
+struct bitcoinrpc_objpool
+bitcoinrpc_objpool_t;
+
+/* Keep at most max objects of each kind (0 means no limit) */
+bitcoinrpc_objpool_t *
+bitcoinrpc_objpool_init(size_t max);
+
+/* Free the pool and the objects in it (not those got from it) */
+BITCOINRPCEcode
+bitcoinrpc_objpool_free(bitcoinrpc_objpool_t *pool);
+
+/*
+   Get a method (as if initialised with bitcoinrpc_method_init_params()).
+   Return NULL in case of error.
+ */
+bitcoinrpc_method_t *
+bitcoinrpc_objpool_get_method(bitcoinrpc_objpool_t *pool, const BITCOINRPC_METHOD m,
+                              json_t * const params);
+
+/*
+   Put the method back into the pool; do not use it afterwards.
+   Methods of any origin may be put (and those got from the pool may be
+   freed with bitcoinrpc_method_free()).
+ */
+BITCOINRPCEcode
+bitcoinrpc_objpool_put_method(bitcoinrpc_objpool_t *pool, bitcoinrpc_method_t *method);
+
+/* Get a response (as if initialised with bitcoinrpc_resp_init()) */
+bitcoinrpc_resp_t *
+bitcoinrpc_objpool_get_resp(bitcoinrpc_objpool_t *pool);
+
+/* Put the response back into the pool; do not use it afterwards */
+BITCOINRPCEcode
+bitcoinrpc_objpool_put_resp(bitcoinrpc_objpool_t *pool, bitcoinrpc_resp_t *resp);
+
+
 /* ------------- bitcoinrpc_call --------------------- */
 
 /*
@@ -375,10 +588,339 @@ bitcoinrpc_call(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t * method,
    response in the contingent array resps of pointers to response objects
    (also of the length n). Save error messages in e. If e == NULL, it
    is ignored. If n == 1, it is the same as bitcoinrpc_call().
+   The responses are matched with the methods by their ids, in whatever
+   order the server sends them back.
  */
 BITCOINRPCEcode
 bitcoinrpc_calln(bitcoinrpc_cl_t * cl, size_t n, bitcoinrpc_method_t **methods,
                  bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e);
 
+/*
+   Callback of a streamed call: the response to methods[i], valid only until
+   the callback returns.  Return 0 to go on, or anything else to stop the call.
+ */
+typedef int
+(*bitcoinrpc_stream_cb_t)(bitcoinrpc_cl_t *cl, size_t i, bitcoinrpc_method_t *method,
+                          bitcoinrpc_resp_t *resp, void *userdata);
+
+/*
+   Like bitcoinrpc_calln(), but hand every response of the batch to callback
+   as soon as it has been received and parsed, while the rest is still on
+   its way.  The responses are not kept (nor cached, coalesced or hedged),
+   and the batch is not split into chunks.
+ */
+BITCOINRPCEcode
+bitcoinrpc_calln_stream(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods,
+                        bitcoinrpc_stream_cb_t callback, void *userdata,
+                        bitcoinrpc_err_t *e);
+
+
+/* ------------- asynchronous calls --------------------- */
+
+/*
+   Callback of an asynchronous call.  The error e is never NULL and is valid
+   only until the callback returns.
+ */
+typedef void
+(*bitcoinrpc_callback_t)(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                         bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e,
+                         void *userdata);
+
+/*
+   Submit a call of method to be performed in the background.  The request
+   is serialised at once, but method and resp must stay valid until
+   the callback (if not NULL) is called.  Many calls can be in flight at
+   the same time, each over its own connection; they finish in any order.
+   Callbacks are called from bitcoinrpc_cl_poll() and bitcoinrpc_cl_run(),
+   and may submit new calls.
+ */
+BITCOINRPCEcode
+bitcoinrpc_call_async(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                      bitcoinrpc_resp_t *resp, bitcoinrpc_callback_t callback,
+                      void *userdata);
+
+/*
+   Push the asynchronous calls forward: wait at most timeout_ms milliseconds
+   for network activity and call the callbacks of the calls that have
+   finished.  Store the number of calls still in flight in pending,
+   if not NULL.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_poll(bitcoinrpc_cl_t *cl, int timeout_ms, size_t *pending);
+
+/*
+   Open at most maxconn connections for asynchronous calls (0 means no limit,
+   the default).  Calls above the limit wait in a queue.  Mind that bitcoind
+   answers with an error, if it gets more parallel requests than its
+   -rpcthreads and -rpcworkqueue allow.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_async_maxconn(bitcoinrpc_cl_t *cl, size_t maxconn);
+
+/* Call bitcoinrpc_cl_poll() until there are no calls in flight */
+BITCOINRPCEcode
+bitcoinrpc_cl_run(bitcoinrpc_cl_t *cl);
+
+
+/*
+   Instead of polling, asynchronous calls can be driven by the user's own
+   event loop.  The client tells which sockets to watch and when to time out
+   via callbacks; the loop reports back with bitcoinrpc_cl_socket_action().
+ */
+
+/* Events on a socket: what to watch for, or what has happened */
+#define BITCOINRPC_SOCKET_IN     1
+#define BITCOINRPC_SOCKET_OUT    2
+#define BITCOINRPC_SOCKET_INOUT  3
+#define BITCOINRPC_SOCKET_REMOVE 4  /* stop watching the socket */
+
+/* Pass it as fd to bitcoinrpc_cl_socket_action(), when the timer expires */
+#define BITCOINRPC_SOCKET_TIMEOUT (-1)
+
+/* Watch fd for events what (or stop watching, if BITCOINRPC_SOCKET_REMOVE) */
+typedef void
+(*bitcoinrpc_socket_cb_t)(bitcoinrpc_cl_t *cl, int fd, int what,
+                          void *userdata);
+
+/*
+   (Re)arm a single timer to expire in timeout_ms milliseconds
+   (0 means: as soon as possible); if timeout_ms == -1, disarm it.
+ */
+typedef void
+(*bitcoinrpc_timer_cb_t)(bitcoinrpc_cl_t *cl, long timeout_ms, void *userdata);
+
+/*
+   Switch the client to the event-driven mode (or back to polling, if both
+   callbacks are NULL).  Cannot be done while calls are in flight.
+   In the event-driven mode, bitcoinrpc_cl_poll() and bitcoinrpc_cl_run()
+   return BITCOINRPCE_ERR.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_event_callbacks(bitcoinrpc_cl_t *cl,
+                                  bitcoinrpc_socket_cb_t socket_cb,
+                                  bitcoinrpc_timer_cb_t timer_cb,
+                                  void *userdata);
+
+/*
+   Tell the client that events (BITCOINRPC_SOCKET_IN/OUT) have happened on fd,
+   or that the timer has expired (fd == BITCOINRPC_SOCKET_TIMEOUT).
+   The callbacks of the calls that have finished are called from here.
+   Store the number of calls still in flight in pending, if not NULL.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_socket_action(bitcoinrpc_cl_t *cl, int fd, int events,
+                            size_t *pending);
+
+
+/* ------------- statistics --------------------- */
+
+/* Buckets of the latency histogram: 1us wide at first, then 1/8 of a power of two */
+#define BITCOINRPC_STATS_BUCKETS 280
+
+/* errors[] is indexed by BITCOINRPCEcode */
+#define BITCOINRPC_STATS_ECODES (BITCOINRPCE_BUSY + 1)
+
+/*
+   Counters of the calls of one method.  errors[BITCOINRPCE_SERV] counts
+   responses in which the server has reported an error; the other codes
+   count the calls which have failed with them.
+ */
+struct bitcoinrpc_stats {
+  BITCOINRPC_METHOD m;
+  const char *name;       /* owned by the client */
+  unsigned long long calls;
+  unsigned long long errors[BITCOINRPC_STATS_ECODES];
+  unsigned long long req_bytes;     /* sent */
+  unsigned long long resp_bytes;    /* received */
+  unsigned long long latency[BITCOINRPC_STATS_BUCKETS];
+};
+
+typedef
+struct bitcoinrpc_stats
+bitcoinrpc_stats_t;
+
+/*
+   Start counting the calls made by the client, per method (nonstandard
+   methods by their names).  There is no cost, until this is called.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_stats(bitcoinrpc_cl_t *cl);
+
+/*
+   Get a snapshot of the statistics of the methods called so far.  Store the
+   number of them in n.  Free the array with bitcoinrpc_stats_free().
+   Return NULL in case of error, or if the statistics are not enabled.
+ */
+bitcoinrpc_stats_t *
+bitcoinrpc_cl_get_stats(bitcoinrpc_cl_t *cl, size_t *n);
+
+BITCOINRPCEcode
+bitcoinrpc_stats_free(bitcoinrpc_stats_t *stats);
+
+/* Set all the counters to zero */
+BITCOINRPCEcode
+bitcoinrpc_cl_reset_stats(bitcoinrpc_cl_t *cl);
+
+/*
+   The latency (in seconds) below which the fraction q of the calls have
+   finished, e.g. q = 0.99 for p99.  Return -1, if q is not within [0, 1].
+ */
+double
+bitcoinrpc_stats_percentile(const bitcoinrpc_stats_t *stats, double q);
+
+
+/* ------------- cache --------------------- */
+
+struct bitcoinrpc_cachestats {
+  unsigned long long hits;
+  unsigned long long misses;
+  size_t entries;
+  size_t bytes;           /* of the results, serialised, and their keys */
+};
+
+typedef
+struct bitcoinrpc_cachestats
+bitcoinrpc_cachestats_t;
+
+/*
+   Keep the results of the methods which do not change for given params
+   (getblock, verbose getrawtransaction of confirmed transactions,
+   decoderawtransaction, decodescript and the nonstandard getblockheader),
+   up to max_bytes, and serve them without asking the server.  The least
+   recently used results are dropped first.  Return BITCOINRPCE_ERR, if the
+   cache has been enabled already.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_cache(bitcoinrpc_cl_t *cl, size_t max_bytes);
+
+/* Copy the counters of the cache; BITCOINRPCE_ERR, if it is not enabled */
+BITCOINRPCEcode
+bitcoinrpc_cl_get_cachestats(bitcoinrpc_cl_t *cl, bitcoinrpc_cachestats_t *cachestats);
+
+/* Drop all the results and set the counters to zero */
+BITCOINRPCEcode
+bitcoinrpc_cl_clear_cache(bitcoinrpc_cl_t *cl);
+
+
+/* ------------- single flight --------------------- */
+
+/*
+   Let the threads sharing the client wait for a call of the same method
+   (the same name and params) already in flight, and get its response,
+   instead of sending their own.  Only calls of one method are coalesced.
+   Return BITCOINRPCE_ERR, if enabled already.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_single_flight(bitcoinrpc_cl_t *cl);
+
+/* The number of calls which have waited for another one */
+BITCOINRPCEcode
+bitcoinrpc_cl_get_coalesced(bitcoinrpc_cl_t *cl, unsigned long long *coalesced);
+
+
+/* ------------- nodes --------------------- */
+
+/* The most nodes of a client, the client itself included */
+#define BITCOINRPC_NODES_MAX 16
+
+/* How the node for a call is chosen (see: bitcoinrpc_cl_set_balance()) */
+typedef enum {
+  BITCOINRPC_BALANCE_LEAST_OUTSTANDING,   /* the fewest calls in progress (the default) */
+  BITCOINRPC_BALANCE_EWMA                 /* the lowest average latency, times */
+                                          /* the calls in progress (plus one) */
+} BITCOINRPC_BALANCE;
+
+struct bitcoinrpc_nodestats {
+  char addr[BITCOINRPC_PARAM_MAXLEN];
+  unsigned int port;
+  size_t outstanding;       /* calls in progress */
+  double ewma;              /* average latency of successful calls, in seconds */
+  unsigned long long calls;
+  unsigned long long errors;
+  int ejected;
+};
+
+typedef
+struct bitcoinrpc_nodestats
+bitcoinrpc_nodestats_t;
+
+/*
+   Add a node (e.g. a replica of the server of the client) to balance the
+   blocking calls of the client among.  The node gets connections of its
+   own, as many as the client has.  Add the nodes before the client is
+   shared by many threads.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_add_node(bitcoinrpc_cl_t *cl, const char* user, const char* pass,
+                       const char* addr, const unsigned int port);
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_balance(bitcoinrpc_cl_t *cl, BITCOINRPC_BALANCE balance);
+
+/*
+   Eject a node for seconds, after failures calls in a row have failed
+   to reach it (3 and 10 seconds by default).
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_set_ejection(bitcoinrpc_cl_t *cl, unsigned int failures, double seconds);
+
+/*
+   Copy the counters of at most *n nodes to nodestats, the client first;
+   store the number of the nodes in n.  BITCOINRPCE_ERR, if no node has
+   been added.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_get_nodestats(bitcoinrpc_cl_t *cl, bitcoinrpc_nodestats_t *nodestats,
+                            size_t *n);
+
+
+/* ------------- hedging --------------------- */
+
+/*
+   Hedge the blocking calls of the methods which only read the state of
+   the server (not the wallet): if a call has not finished after the
+   latency percentile q of its method (0 < q < 1, e.g. 0.95), but at least
+   delay seconds, send it to another node as well; take the response which
+   comes first and cancel the other request.  This needs nodes added to the
+   client, and enables its statistics.  Return BITCOINRPCE_ERR, if enabled
+   already.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_hedging(bitcoinrpc_cl_t *cl, double q, double delay);
+
+/* The number of calls sent to another node too, and how many it has won */
+BITCOINRPCEcode
+bitcoinrpc_cl_get_hedged(bitcoinrpc_cl_t *cl, unsigned long long *hedged,
+                         unsigned long long *won);
+
+
+/* ------------- concurrency limit --------------------- */
+
+struct bitcoinrpc_limitstats {
+  double limit;                   /* calls allowed in flight now */
+  size_t inflight;
+  size_t waiting;
+  unsigned long long overloads;   /* calls refused by the server (HTTP 503) */
+  unsigned long long rejected;    /* calls failed, too many waiting */
+};
+
+typedef
+struct bitcoinrpc_limitstats
+bitcoinrpc_limitstats_t;
+
+/*
+   Limit the blocking calls of the client in flight to between min and max,
+   adapting to the server: the limit grows while the calls keep their
+   latency, and is halved when the work queue of the server gets full
+   (HTTP 503) or the latency grows.  At most queue calls wait for their
+   turn; then the calls fail with BITCOINRPCE_ERR.  A call refused by the
+   server is sent again, after waiting.  Return BITCOINRPCE_ERR, if enabled
+   already.
+ */
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_limit(bitcoinrpc_cl_t *cl, size_t min, size_t max, size_t queue);
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_limitstats(bitcoinrpc_cl_t *cl, bitcoinrpc_limitstats_t *limitstats);
 
 #endif /* BITCOINRPC_H_51fe7847_aafe_4e78_9823_eff094a30775 */
@@ -0,0 +1,520 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+   Asynchronous calls: many transfers driven by one curl multi handle,
+   either polled by the user or fed by the user's event loop.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+#include "bitcoinrpc_call.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_err.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_stats.h"
+
+
+/* How long bitcoinrpc_cl_run() waits for activity in one round */
+#define BITCOINRPC_ASYNC_WAIT_MS 1000
+
+
+/*
+   One call in flight.  Finished transfers are kept by the client and reused,
+   together with their curl handle (and so its connection) and buffers.
+ */
+struct bitcoinrpc_async_ {
+  CURL *curl;
+  struct bitcoinrpc_buf_ sendbuf;    /* POST data */
+  struct bitcoinrpc_buf_ recvbuf;
+  struct bitcoinrpc_call_curl_resp_ curl_resp;
+  char curl_errbuf[CURL_ERROR_SIZE];
+
+  bitcoinrpc_method_t *method;
+  bitcoinrpc_resp_t *resp;
+  bitcoinrpc_callback_t callback;
+  void *userdata;
+  double t0;                         /* when the call was submitted */
+
+  struct bitcoinrpc_async_ *prev;
+  struct bitcoinrpc_async_ *next;
+};
+
+
+static void
+bitcoinrpc_async_free_(struct bitcoinrpc_async_ *a)
+{
+  curl_easy_cleanup(a->curl);
+  json_decref(a->curl_resp.batch);    /* of an aborted transfer */
+  bitcoinrpc_buf_free_(&a->curl_resp.arena);
+  bitcoinrpc_buf_free_(&a->sendbuf);
+  bitcoinrpc_buf_free_(&a->recvbuf);
+  bitcoinrpc_global_freefunc(a);
+}
+
+
+static struct bitcoinrpc_async_ *
+bitcoinrpc_async_get_(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_async_ *a = NULL;
+
+  if (NULL != cl->async_free)
+    {
+      a = cl->async_free;
+      cl->async_free = a->next;
+      return a;
+    }
+
+  a = bitcoinrpc_global_allocfunc(sizeof *a);
+  if (NULL == a)
+    return NULL;
+
+  a->curl = curl_easy_init();
+  if (NULL == a->curl)
+    {
+      bitcoinrpc_global_freefunc(a);
+      return NULL;
+    }
+  bitcoinrpc_buf_init_(&a->sendbuf);
+  bitcoinrpc_buf_init_(&a->recvbuf);
+  bitcoinrpc_call_setup_(cl, a->curl, &a->curl_resp, a->curl_errbuf);
+
+  return a;
+}
+
+
+/* Move a from the list of active transfers to the free list */
+static void
+bitcoinrpc_async_put_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_async_ *a)
+{
+  if (NULL != a->prev)
+    a->prev->next = a->next;
+  else
+    cl->async_active = a->next;
+  if (NULL != a->next)
+    a->next->prev = a->prev;
+
+  a->prev = NULL;
+  a->next = cl->async_free;
+  cl->async_free = a;
+}
+
+
+/* Call the callbacks of the finished transfers */
+static BITCOINRPCEcode
+bitcoinrpc_async_done_(bitcoinrpc_cl_t *cl)
+{
+  CURLMsg *msg = NULL;
+  int msgs_left = 0;
+  struct bitcoinrpc_async_ *a = NULL;
+  bitcoinrpc_err_t e;
+
+  while ((msg = curl_multi_info_read(cl->curlm, &msgs_left)) != NULL)
+    {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&a);
+      if (NULL == a)
+        return BITCOINRPCE_BUG;
+
+      CURLcode curl_err = msg->data.result;
+      curl_multi_remove_handle(cl->curlm, a->curl);
+      bitcoinrpc_buf_shrink_(&a->sendbuf);
+
+      e.code = BITCOINRPCE_OK;
+      e.msg[0] = '\0';
+      bitcoinrpc_call_finish_(a->curl, curl_err, a->curl_errbuf, &a->curl_resp,
+                              1, &a->method, &a->resp, &e);
+      bitcoinrpc_stats_record_(cl, 1, &a->method, &a->resp, e.code,
+                               bitcoinrpc_call_now_() - a->t0);
+      cl->async_pending--;
+
+      /* the callback may submit new calls, so let it reuse a */
+      bitcoinrpc_async_put_(cl, a);
+      if (NULL != a->callback)
+        a->callback(cl, a->method, a->resp, &e, a->userdata);
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+static int
+bitcoinrpc_async_socket_cb_(CURL *curl, curl_socket_t s, int what,
+                            void *userp, void *socketp)
+{
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)userp;
+  int w = 0;
+
+  (void)curl;
+  (void)socketp;
+
+  if (NULL == cl->event_socket_cb)
+    return 0;
+
+  if (what == CURL_POLL_REMOVE)
+    w = BITCOINRPC_SOCKET_REMOVE;
+  else
+    {
+      if (what & CURL_POLL_IN)
+        w |= BITCOINRPC_SOCKET_IN;
+      if (what & CURL_POLL_OUT)
+        w |= BITCOINRPC_SOCKET_OUT;
+    }
+  cl->event_socket_cb(cl, (int)s, w, cl->event_userdata);
+
+  return 0;
+}
+
+
+static int
+bitcoinrpc_async_timer_cb_(CURLM *curlm, long timeout_ms, void *userp)
+{
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)userp;
+
+  (void)curlm;
+
+  if (NULL != cl->event_timer_cb)
+    cl->event_timer_cb(cl, timeout_ms, cl->event_userdata);
+
+  return 0;
+}
+
+
+/* Create the multi handle and set it up according to the client's options */
+static BITCOINRPCEcode
+bitcoinrpc_async_init_multi_(bitcoinrpc_cl_t *cl)
+{
+  if (NULL != cl->curlm)
+    return BITCOINRPCE_OK;
+
+  cl->curlm = curl_multi_init();
+  if (NULL == cl->curlm)
+    return BITCOINRPCE_CURLE;
+
+  curl_multi_setopt(cl->curlm, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                    (long)cl->async_maxconn);
+
+  if (NULL != cl->event_socket_cb || NULL != cl->event_timer_cb)
+    {
+      curl_multi_setopt(cl->curlm, CURLMOPT_SOCKETFUNCTION,
+                        bitcoinrpc_async_socket_cb_);
+      curl_multi_setopt(cl->curlm, CURLMOPT_SOCKETDATA, cl);
+      curl_multi_setopt(cl->curlm, CURLMOPT_TIMERFUNCTION,
+                        bitcoinrpc_async_timer_cb_);
+      curl_multi_setopt(cl->curlm, CURLMOPT_TIMERDATA, cl);
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+/* ------------------------------------------------------------------------ */
+
+static BITCOINRPCEcode
+bitcoinrpc_call_async_(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                       bitcoinrpc_resp_t *resp, bitcoinrpc_callback_t callback,
+                       void *userdata)
+{
+  struct bitcoinrpc_async_ *a = NULL;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl || NULL == method || NULL == resp)
+    return BITCOINRPCE_ARG;
+
+  ecode = bitcoinrpc_async_init_multi_(cl);
+  if (ecode != BITCOINRPCE_OK)
+    return ecode;
+
+  a = bitcoinrpc_async_get_(cl);
+  if (NULL == a)
+    return BITCOINRPCE_ALLOC;
+
+  a->method = method;
+  a->resp = resp;
+  a->callback = callback;
+  a->userdata = userdata;
+  a->t0 = bitcoinrpc_call_now_();
+
+  ecode = bitcoinrpc_call_prepare_(cl, a->curl, 1, &a->method, &a->curl_resp,
+                                   &a->sendbuf, &a->recvbuf, NULL);
+  if (ecode != BITCOINRPCE_OK)
+    {
+      a->next = cl->async_free;
+      cl->async_free = a;
+      return ecode;
+    }
+  curl_easy_setopt(a->curl, CURLOPT_PRIVATE, a);
+
+  if (curl_multi_add_handle(cl->curlm, a->curl) != CURLM_OK)
+    {
+      a->next = cl->async_free;
+      cl->async_free = a;
+      return BITCOINRPCE_CURLE;
+    }
+
+  a->prev = NULL;
+  a->next = cl->async_active;
+  if (NULL != a->next)
+    a->next->prev = a;
+  cl->async_active = a;
+  cl->async_pending++;
+
+  return BITCOINRPCE_OK;
+}
+
+
+/* Whatever the client allocates for asynchronous calls is charged to it */
+BITCOINRPCEcode
+bitcoinrpc_call_async(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                      bitcoinrpc_resp_t *resp, bitcoinrpc_callback_t callback,
+                      void *userdata)
+{
+  struct bitcoinrpc_global_scope_ scope;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  bitcoinrpc_global_enter_(&scope, cl->account, NULL);
+  ecode = bitcoinrpc_call_async_(cl, method, resp, callback, userdata);
+  bitcoinrpc_global_leave_(&scope);
+
+  return ecode;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_async_maxconn(bitcoinrpc_cl_t *cl, size_t maxconn)
+{
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  cl->async_maxconn = maxconn;
+  if (NULL != cl->curlm)
+    curl_multi_setopt(cl->curlm, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                      (long)maxconn);
+
+  return BITCOINRPCE_OK;
+}
+
+
+static BITCOINRPCEcode
+bitcoinrpc_cl_poll_(bitcoinrpc_cl_t *cl, int timeout_ms, size_t *pending)
+{
+  int running = 0;
+
+  if (NULL == cl || timeout_ms < 0)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->event_socket_cb || NULL != cl->event_timer_cb)
+    return BITCOINRPCE_ERR;
+
+  if (NULL == cl->curlm || 0 == cl->async_pending)
+    {
+      if (NULL != pending)
+        *pending = 0;
+      return BITCOINRPCE_OK;
+    }
+
+  if (curl_multi_perform(cl->curlm, &running) != CURLM_OK)
+    return BITCOINRPCE_CURLE;
+  if (bitcoinrpc_async_done_(cl) != BITCOINRPCE_OK)
+    return BITCOINRPCE_BUG;
+
+  if (running > 0 && timeout_ms > 0)
+    {
+      if (curl_multi_wait(cl->curlm, NULL, 0, timeout_ms, NULL) != CURLM_OK)
+        return BITCOINRPCE_CURLE;
+      if (curl_multi_perform(cl->curlm, &running) != CURLM_OK)
+        return BITCOINRPCE_CURLE;
+      if (bitcoinrpc_async_done_(cl) != BITCOINRPCE_OK)
+        return BITCOINRPCE_BUG;
+    }
+
+  if (NULL != pending)
+    *pending = cl->async_pending;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_poll(bitcoinrpc_cl_t *cl, int timeout_ms, size_t *pending)
+{
+  struct bitcoinrpc_global_scope_ scope;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  bitcoinrpc_global_enter_(&scope, cl->account, NULL);
+  ecode = bitcoinrpc_cl_poll_(cl, timeout_ms, pending);
+  bitcoinrpc_global_leave_(&scope);
+
+  return ecode;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_run(bitcoinrpc_cl_t *cl)
+{
+  size_t pending = 0;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->event_socket_cb || NULL != cl->event_timer_cb)
+    return BITCOINRPCE_ERR;
+
+  do
+    {
+      ecode = bitcoinrpc_cl_poll(cl, BITCOINRPC_ASYNC_WAIT_MS, &pending);
+      if (ecode != BITCOINRPCE_OK)
+        return ecode;
+    }
+  while (pending > 0);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_event_callbacks(bitcoinrpc_cl_t *cl,
+                                  bitcoinrpc_socket_cb_t socket_cb,
+                                  bitcoinrpc_timer_cb_t timer_cb,
+                                  void *userdata)
+{
+  if (NULL == cl || (NULL == socket_cb) != (NULL == timer_cb))
+    return BITCOINRPCE_ARG;
+
+  if (cl->async_pending > 0)
+    return BITCOINRPCE_ERR;
+
+  cl->event_socket_cb = socket_cb;
+  cl->event_timer_cb = timer_cb;
+  cl->event_userdata = userdata;
+
+  /* the multi handle will be set up again on the next call */
+  if (NULL != cl->curlm)
+    {
+      curl_multi_cleanup(cl->curlm);
+      cl->curlm = NULL;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+static BITCOINRPCEcode
+bitcoinrpc_cl_socket_action_(bitcoinrpc_cl_t *cl, int fd, int events,
+                             size_t *pending)
+{
+  int running = 0;
+  int ev = 0;
+  curl_socket_t s = (fd == BITCOINRPC_SOCKET_TIMEOUT) ?
+                    CURL_SOCKET_TIMEOUT : (curl_socket_t)fd;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (NULL == cl->curlm)
+    {
+      if (NULL != pending)
+        *pending = 0;
+      return BITCOINRPCE_OK;
+    }
+
+  if (events & BITCOINRPC_SOCKET_IN)
+    ev |= CURL_CSELECT_IN;
+  if (events & BITCOINRPC_SOCKET_OUT)
+    ev |= CURL_CSELECT_OUT;
+
+  if (curl_multi_socket_action(cl->curlm, s, ev, &running) != CURLM_OK)
+    return BITCOINRPCE_CURLE;
+  if (bitcoinrpc_async_done_(cl) != BITCOINRPCE_OK)
+    return BITCOINRPCE_BUG;
+
+  if (NULL != pending)
+    *pending = cl->async_pending;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_socket_action(bitcoinrpc_cl_t *cl, int fd, int events,
+                            size_t *pending)
+{
+  struct bitcoinrpc_global_scope_ scope;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  bitcoinrpc_global_enter_(&scope, cl->account, NULL);
+  ecode = bitcoinrpc_cl_socket_action_(cl, fd, events, pending);
+  bitcoinrpc_global_leave_(&scope);
+
+  return ecode;
+}
+
+
+void
+bitcoinrpc_call_async_cleanup_(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_async_ *a = NULL;
+
+  /* do not bother the user's event loop any more */
+  cl->event_socket_cb = NULL;
+  cl->event_timer_cb = NULL;
+
+  while (NULL != cl->async_active)
+    {
+      a = cl->async_active;
+      cl->async_active = a->next;
+      curl_multi_remove_handle(cl->curlm, a->curl);
+      bitcoinrpc_async_free_(a);
+    }
+  while (NULL != cl->async_free)
+    {
+      a = cl->async_free;
+      cl->async_free = a->next;
+      bitcoinrpc_async_free_(a);
+    }
+  cl->async_pending = 0;
+
+  if (NULL != cl->curlm)
+    {
+      curl_multi_cleanup(cl->curlm);
+      cl->curlm = NULL;
+    }
+}
@@ -0,0 +1,167 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+#include "bitcoinrpc_global.h"
+
+
+void
+bitcoinrpc_buf_init_(struct bitcoinrpc_buf_ *b)
+{
+  b->data = NULL;
+  b->len = 0;
+  b->cap = 0;
+}
+
+
+void
+bitcoinrpc_buf_free_(struct bitcoinrpc_buf_ *b)
+{
+  if (NULL != b->data)
+    bitcoinrpc_global_freefunc(b->data);
+  bitcoinrpc_buf_init_(b);
+}
+
+
+void
+bitcoinrpc_buf_clear_(struct bitcoinrpc_buf_ *b)
+{
+  b->len = 0;
+  if (NULL != b->data)
+    b->data[0] = '\0';
+}
+
+
+void
+bitcoinrpc_buf_shrink_(struct bitcoinrpc_buf_ *b)
+{
+  if (b->cap > BITCOINRPC_BUF_KEEPMAX)
+    bitcoinrpc_buf_free_(b);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_buf_reserve_(struct bitcoinrpc_buf_ *b, size_t n)
+{
+  size_t need = b->len + n + 1;
+  size_t cap;
+  char *data = NULL;
+
+  if (need < n)
+    return BITCOINRPCE_ALLOC;   /* overflow */
+
+  if (need <= b->cap)
+    return BITCOINRPCE_OK;
+
+  /*
+     Grow geometrically, so that appending n bytes in small chunks
+     costs O(n) in total.  There is no realloc hook in the global state,
+     hence alloc, copy and free.
+   */
+  cap = (b->cap < BITCOINRPC_BUF_MINCAP) ? BITCOINRPC_BUF_MINCAP : b->cap;
+  while (cap < need)
+    {
+      if (cap > ((size_t)-1) / 2)
+        {
+          cap = need;
+          break;
+        }
+      cap *= 2;
+    }
+
+  data = bitcoinrpc_global_allocfunc(cap);
+  if (NULL == data)
+    return BITCOINRPCE_ALLOC;
+
+  if (NULL != b->data)
+    {
+      memcpy(data, b->data, b->len);
+      bitcoinrpc_global_freefunc(b->data);
+    }
+  data[b->len] = '\0';
+  b->data = data;
+  b->cap = cap;
+
+  return BITCOINRPCE_OK;
+}
+
+
+void *
+bitcoinrpc_buf_alloc_(struct bitcoinrpc_buf_ *b, size_t n)
+{
+  size_t start = (b->len + BITCOINRPC_BUF_ALIGN - 1) & ~(size_t)(BITCOINRPC_BUF_ALIGN - 1);
+
+  if (NULL == b->data || start >= b->cap || b->cap - start <= n)
+    return NULL;
+
+  b->len = start + n;
+  b->data[b->len] = '\0';
+
+  return b->data + start;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_buf_append_(struct bitcoinrpc_buf_ *b, const char *ptr, size_t n)
+{
+  if (bitcoinrpc_buf_reserve_(b, n) != BITCOINRPCE_OK)
+    return BITCOINRPCE_ALLOC;
+
+  memcpy(b->data + b->len, ptr, n);
+  b->len += n;
+  b->data[b->len] = '\0';
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_buf_append_nonl_(struct bitcoinrpc_buf_ *b, const char *ptr, size_t n)
+{
+  const char *end = ptr + n;
+  const char *nl = NULL;
+  char *dst = NULL;
+
+  if (bitcoinrpc_buf_reserve_(b, n) != BITCOINRPCE_OK)
+    return BITCOINRPCE_ALLOC;
+
+  /* copy whole runs between newlines; memchr() is vectorised by libc */
+  dst = b->data + b->len;
+  while (ptr < end)
+    {
+      nl = memchr(ptr, '\n', end - ptr);
+      if (NULL == nl)
+        nl = end;
+      memcpy(dst, ptr, nl - ptr);
+      dst += nl - ptr;
+      ptr = nl + 1;
+    }
+  b->len = dst - b->data;
+  b->data[b->len] = '\0';
+
+  return BITCOINRPCE_OK;
+}
@@ -0,0 +1,87 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+   Growable byte buffers used internally by the library
+ */
+
+#ifndef BITCOINRPC_BUF_H_ebe0d5b6_bacd_4949_8a3b_63ff6d932f45
+#define BITCOINRPC_BUF_H_ebe0d5b6_bacd_4949_8a3b_63ff6d932f45
+
+#include <stddef.h>
+#include "bitcoinrpc.h"
+
+/* The smallest chunk of memory a buffer allocates */
+#define BITCOINRPC_BUF_MINCAP 4096
+
+/*
+   A buffer is kept allocated between calls; if it has grown bigger than that
+   (e.g. after a huge reply), it is released by bitcoinrpc_buf_shrink_()
+ */
+#define BITCOINRPC_BUF_KEEPMAX (4 * 1024 * 1024)
+
+struct bitcoinrpc_buf_ {
+  char *data;         /* always '\0' terminated, if not NULL */
+  size_t len;         /* not counting the terminating '\0' */
+  size_t cap;         /* allocated size */
+};
+
+void
+bitcoinrpc_buf_init_(struct bitcoinrpc_buf_ *b);
+
+void
+bitcoinrpc_buf_free_(struct bitcoinrpc_buf_ *b);
+
+/* Forget the content, but keep the memory */
+void
+bitcoinrpc_buf_clear_(struct bitcoinrpc_buf_ *b);
+
+/* Release the memory, if the buffer has grown above BITCOINRPC_BUF_KEEPMAX */
+void
+bitcoinrpc_buf_shrink_(struct bitcoinrpc_buf_ *b);
+
+/* Make room for at least n more bytes (and the terminating '\0') */
+BITCOINRPCEcode
+bitcoinrpc_buf_reserve_(struct bitcoinrpc_buf_ *b, size_t n);
+
+/* Blocks taken with bitcoinrpc_buf_alloc_() are aligned to that */
+#define BITCOINRPC_BUF_ALIGN 16
+
+/*
+   Use the buffer as a bump arena: take n bytes from the room made with
+   bitcoinrpc_buf_reserve_().  The buffer does not grow (so the blocks taken
+   before stay where they are); return NULL, if there is not enough room.
+   All the blocks are released at once by bitcoinrpc_buf_clear_().
+ */
+void *
+bitcoinrpc_buf_alloc_(struct bitcoinrpc_buf_ *b, size_t n);
+
+BITCOINRPCEcode
+bitcoinrpc_buf_append_(struct bitcoinrpc_buf_ *b, const char *ptr, size_t n);
+
+/* Append n bytes from ptr, skipping all the '\n' characters */
+BITCOINRPCEcode
+bitcoinrpc_buf_append_nonl_(struct bitcoinrpc_buf_ *b, const char *ptr, size_t n);
+
+#endif /* BITCOINRPC_BUF_H_ebe0d5b6_bacd_4949_8a3b_63ff6d932f45 */
@@ -0,0 +1,402 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Cache of the results of the calls which do not change: an LRU list of
+   entries, indexed by a hash table of their keys, all under one lock.
+   Methods are identified by bitcoinrpc_method_key_().
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_cache.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_method.h"
+
+
+#define BITCOINRPC_CACHE_BUCKETS_ 64      /* at first; then as many as entries */
+
+struct bitcoinrpc_cache_entry_ {
+  struct bitcoinrpc_cache_entry_ *hnext;    /* in the bucket */
+  struct bitcoinrpc_cache_entry_ *prev;     /* towards the most recently used */
+  struct bitcoinrpc_cache_entry_ *next;
+  size_t hash;
+  size_t bytes;           /* counted against the capacity */
+  json_t *result;
+  size_t key_len;
+  char key[];
+};
+
+struct bitcoinrpc_cache_ {
+  pthread_mutex_t lock;
+  size_t max_bytes;
+  size_t bytes;
+  size_t nentries;
+
+  struct bitcoinrpc_cache_entry_ **buckets;
+  size_t mask;            /* buckets - 1, a power of two */
+  struct bitcoinrpc_cache_entry_ *head;     /* the most recently used */
+  struct bitcoinrpc_cache_entry_ *tail;
+
+  unsigned long long hits;
+  unsigned long long misses;
+};
+
+
+/* Call with the lock held */
+static struct bitcoinrpc_cache_entry_ *
+bitcoinrpc_cache_find_(struct bitcoinrpc_cache_ *cache, const char *key,
+                       size_t len, size_t hash)
+{
+  struct bitcoinrpc_cache_entry_ *entry = cache->buckets[hash & cache->mask];
+
+  for (; entry != NULL; entry = entry->hnext)
+    if (entry->hash == hash && entry->key_len == len
+        && memcmp(entry->key, key, len) == 0)
+      return entry;
+
+  return NULL;
+}
+
+
+static void
+bitcoinrpc_cache_unlink_(struct bitcoinrpc_cache_ *cache,
+                         struct bitcoinrpc_cache_entry_ *entry)
+{
+  if (NULL != entry->prev)
+    entry->prev->next = entry->next;
+  else
+    cache->head = entry->next;
+  if (NULL != entry->next)
+    entry->next->prev = entry->prev;
+  else
+    cache->tail = entry->prev;
+}
+
+
+static void
+bitcoinrpc_cache_push_front_(struct bitcoinrpc_cache_ *cache,
+                             struct bitcoinrpc_cache_entry_ *entry)
+{
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (NULL != cache->head)
+    cache->head->prev = entry;
+  cache->head = entry;
+  if (NULL == cache->tail)
+    cache->tail = entry;
+}
+
+
+/* Drop the least recently used entry */
+static void
+bitcoinrpc_cache_evict_(struct bitcoinrpc_cache_ *cache)
+{
+  struct bitcoinrpc_cache_entry_ *entry = cache->tail;
+  struct bitcoinrpc_cache_entry_ **p = &cache->buckets[entry->hash & cache->mask];
+
+  while (*p != entry)
+    p = &(*p)->hnext;
+  *p = entry->hnext;
+  bitcoinrpc_cache_unlink_(cache, entry);
+
+  cache->bytes -= entry->bytes;
+  cache->nentries--;
+  json_decref(entry->result);
+  bitcoinrpc_global_freefunc(entry);
+}
+
+
+/* Twice as many buckets; if there is no memory, the chains just get longer */
+static void
+bitcoinrpc_cache_grow_(struct bitcoinrpc_cache_ *cache)
+{
+  size_t nb = 2 * (cache->mask + 1);
+  struct bitcoinrpc_cache_entry_ **buckets = NULL;
+
+  buckets = bitcoinrpc_global_allocfunc(nb * sizeof *buckets);
+  if (NULL == buckets)
+    return;
+  memset(buckets, 0, nb * sizeof *buckets);
+
+  for (size_t i = 0; i <= cache->mask; i++)
+    {
+      struct bitcoinrpc_cache_entry_ *entry = cache->buckets[i];
+      while (entry != NULL)
+        {
+          struct bitcoinrpc_cache_entry_ *hnext = entry->hnext;
+          entry->hnext = buckets[entry->hash & (nb - 1)];
+          buckets[entry->hash & (nb - 1)] = entry;
+          entry = hnext;
+        }
+    }
+  bitcoinrpc_global_freefunc(cache->buckets);
+  cache->buckets = buckets;
+  cache->mask = nb - 1;
+}
+
+
+/* Call with the lock held */
+static void
+bitcoinrpc_cache_clear_(struct bitcoinrpc_cache_ *cache)
+{
+  while (NULL != cache->tail)
+    bitcoinrpc_cache_evict_(cache);
+}
+
+
+void
+bitcoinrpc_cache_free_(struct bitcoinrpc_cache_ *cache)
+{
+  if (NULL == cache)
+    return;
+
+  bitcoinrpc_cache_clear_(cache);
+  pthread_mutex_destroy(&cache->lock);
+  bitcoinrpc_global_freefunc(cache->buckets);
+  bitcoinrpc_global_freefunc(cache);
+}
+
+
+int
+bitcoinrpc_cache_method_(bitcoinrpc_method_t *method)
+{
+  switch (method->m)
+    {
+    case BITCOINRPC_METHOD_GETBLOCK:
+    case BITCOINRPC_METHOD_GETRAWTRANSACTION:
+    case BITCOINRPC_METHOD_DECODERAWTRANSACTION:
+    case BITCOINRPC_METHOD_DECODESCRIPT:
+      return 1;
+    case BITCOINRPC_METHOD_NONSTANDARD:
+      return NULL != method->mstr && strcmp(method->mstr, "getblockheader") == 0;
+    default:
+      return 0;
+    }
+}
+
+
+/*
+   A transaction may still be dropped from the mempool, or mined in another
+   block: only the verbose result of a confirmed one (with its blockhash)
+   is kept.  The others depend on the params alone.
+ */
+static int
+bitcoinrpc_cache_immutable_(bitcoinrpc_method_t *method, json_t *result)
+{
+  if (BITCOINRPC_METHOD_GETRAWTRANSACTION == method->m)
+    return json_is_object(result) && json_is_string(json_object_get(result, "blockhash"));
+
+  return bitcoinrpc_cache_method_(method);
+}
+
+
+json_t *
+bitcoinrpc_cache_get_(struct bitcoinrpc_cache_ *cache, bitcoinrpc_method_t *method)
+{
+  struct bitcoinrpc_cache_entry_ *entry = NULL;
+  char buf[BITCOINRPC_METHOD_KEYLEN];
+  char *key = NULL;
+  json_t *result = NULL;
+  size_t len, hash;
+
+  key = bitcoinrpc_method_key_(method, buf, &len);
+  if (NULL == key)
+    return NULL;
+  hash = bitcoinrpc_method_key_hash_(key, len);
+
+  pthread_mutex_lock(&cache->lock);
+  entry = bitcoinrpc_cache_find_(cache, key, len, hash);
+  if (NULL != entry)
+    {
+      bitcoinrpc_cache_unlink_(cache, entry);
+      bitcoinrpc_cache_push_front_(cache, entry);
+      /* a copy of its own: the entry is not shared with the responses */
+      result = json_deep_copy(entry->result);
+      cache->hits++;
+    }
+  else
+    {
+      cache->misses++;
+    }
+  pthread_mutex_unlock(&cache->lock);
+
+  bitcoinrpc_method_key_free_(key, buf);
+
+  return result;
+}
+
+
+void
+bitcoinrpc_cache_put_(struct bitcoinrpc_cache_ *cache, bitcoinrpc_method_t *method,
+                      json_t *resp)
+{
+  struct bitcoinrpc_cache_entry_ *entry = NULL;
+  json_t *result = json_object_get(resp, "result");
+  char buf[BITCOINRPC_METHOD_KEYLEN];
+  char *key = NULL;
+  size_t len, bytes;
+
+  if (NULL == result || !json_is_null(json_object_get(resp, "error"))
+      || !bitcoinrpc_cache_immutable_(method, result))
+    return;
+
+  key = bitcoinrpc_method_key_(method, buf, &len);
+  if (NULL == key)
+    return;
+  bytes = sizeof *entry + len + json_dumpb(result, NULL, 0, JSON_COMPACT | JSON_ENCODE_ANY);
+  entry = (bytes <= cache->max_bytes) ? bitcoinrpc_global_allocfunc(sizeof *entry + len) : NULL;
+  if (NULL == entry)
+    {
+      bitcoinrpc_method_key_free_(key, buf);
+      return;
+    }
+  memcpy(entry->key, key, len);
+  bitcoinrpc_method_key_free_(key, buf);
+  entry->key_len = len;
+  entry->hash = bitcoinrpc_method_key_hash_(entry->key, len);
+  entry->bytes = bytes;
+  entry->result = json_deep_copy(result);
+  if (NULL == entry->result)
+    {
+      bitcoinrpc_global_freefunc(entry);
+      return;
+    }
+
+  pthread_mutex_lock(&cache->lock);
+  if (NULL != bitcoinrpc_cache_find_(cache, entry->key, len, entry->hash))
+    {
+      /* another thread has been faster */
+      pthread_mutex_unlock(&cache->lock);
+      json_decref(entry->result);
+      bitcoinrpc_global_freefunc(entry);
+      return;
+    }
+  while (cache->bytes + bytes > cache->max_bytes)
+    bitcoinrpc_cache_evict_(cache);
+  if (cache->nentries > cache->mask)
+    bitcoinrpc_cache_grow_(cache);
+
+  entry->hnext = cache->buckets[entry->hash & cache->mask];
+  cache->buckets[entry->hash & cache->mask] = entry;
+  bitcoinrpc_cache_push_front_(cache, entry);
+  cache->bytes += bytes;
+  cache->nentries++;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+
+/* ------------------------------------------------------------------------  */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_cache(bitcoinrpc_cl_t *cl, size_t max_bytes)
+{
+  struct bitcoinrpc_cache_ *cache = NULL;
+
+  if (NULL == cl || 0 == max_bytes)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->cache)
+    return BITCOINRPCE_ERR;
+
+  cache = bitcoinrpc_global_allocfunc(sizeof *cache);
+  if (NULL == cache)
+    return BITCOINRPCE_ALLOC;
+  memset(cache, 0, sizeof *cache);
+  cache->buckets = bitcoinrpc_global_allocfunc(BITCOINRPC_CACHE_BUCKETS_ * sizeof *cache->buckets);
+  if (NULL == cache->buckets)
+    {
+      bitcoinrpc_global_freefunc(cache);
+      return BITCOINRPCE_ALLOC;
+    }
+  memset(cache->buckets, 0, BITCOINRPC_CACHE_BUCKETS_ * sizeof *cache->buckets);
+  cache->mask = BITCOINRPC_CACHE_BUCKETS_ - 1;
+  cache->max_bytes = max_bytes;
+  if (pthread_mutex_init(&cache->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(cache->buckets);
+      bitcoinrpc_global_freefunc(cache);
+      return BITCOINRPCE_ERR;
+    }
+
+  if (!__sync_bool_compare_and_swap(&cl->cache, NULL, cache))
+    {
+      bitcoinrpc_cache_free_(cache);
+      return BITCOINRPCE_ERR;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_cachestats(bitcoinrpc_cl_t *cl, bitcoinrpc_cachestats_t *cachestats)
+{
+  struct bitcoinrpc_cache_ *cache = NULL;
+
+  if (NULL == cl || NULL == cachestats)
+    return BITCOINRPCE_ARG;
+
+  cache = cl->cache;
+  if (NULL == cache)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&cache->lock);
+  cachestats->hits = cache->hits;
+  cachestats->misses = cache->misses;
+  cachestats->entries = cache->nentries;
+  cachestats->bytes = cache->bytes;
+  pthread_mutex_unlock(&cache->lock);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_clear_cache(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_cache_ *cache = NULL;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  cache = cl->cache;
+  if (NULL == cache)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&cache->lock);
+  bitcoinrpc_cache_clear_(cache);
+  cache->hits = 0;
+  cache->misses = 0;
+  pthread_mutex_unlock(&cache->lock);
+
+  return BITCOINRPCE_OK;
+}
@@ -0,0 +1,63 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Cache of the results of the calls which do not change
+ */
+
+#ifndef BITCOINRPC_CACHE_H_3c8e51a4_7d02_4b96_a1f3_62e0b9d4c7a8
+#define BITCOINRPC_CACHE_H_3c8e51a4_7d02_4b96_a1f3_62e0b9d4c7a8
+
+#include <jansson.h>
+#include "bitcoinrpc.h"
+
+struct bitcoinrpc_cache_;
+
+
+void
+bitcoinrpc_cache_free_(struct bitcoinrpc_cache_ *cache);
+
+/* Whether the results of the method may be cached at all */
+int
+bitcoinrpc_cache_method_(bitcoinrpc_method_t *method);
+
+/*
+   Look the method up (by its name and params) and count a hit or a miss.
+   Return a new reference to the result, or NULL.
+ */
+json_t *
+bitcoinrpc_cache_get_(struct bitcoinrpc_cache_ *cache, bitcoinrpc_method_t *method);
+
+/*
+   Keep the result of the response (a JSON-RPC object) to the method, if
+   the server has reported no error and the result is known not to change.
+   Evict the least recently used results to stay within the capacity.
+ */
+void
+bitcoinrpc_cache_put_(struct bitcoinrpc_cache_ *cache, bitcoinrpc_method_t *method,
+                      json_t *resp);
+
+#endif /* BITCOINRPC_CACHE_H_3c8e51a4_7d02_4b96_a1f3_62e0b9d4c7a8 */
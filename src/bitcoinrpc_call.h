@@ -0,0 +1,137 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+   Internal routines shared by the blocking and asynchronous calls
+ */
+
+#ifndef BITCOINRPC_CALL_H_9738989f_f252_49cf_9ef8_8a6083c69b62
+#define BITCOINRPC_CALL_H_9738989f_f252_49cf_9ef8_8a6083c69b62
+
+#include <curl/curl.h>
+#include <jansson.h>
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+
+
+enum bitcoinrpc_call_stream_ {
+  BITCOINRPC_CALL_STREAM_START,   /* nothing but whitespace so far */
+  BITCOINRPC_CALL_STREAM_ARRAY,   /* inside the batch */
+  BITCOINRPC_CALL_STREAM_DONE,    /* the batch is complete */
+  BITCOINRPC_CALL_STREAM_RAW      /* not a batch: parse the data as a whole */
+};
+
+/*
+   Passed to the curl write callback.  The elements of the batch are parsed
+   as soon as they have arrived, so buf keeps only the data not parsed yet.
+ */
+struct bitcoinrpc_call_curl_resp_ {
+  struct bitcoinrpc_buf_ *buf;
+  bitcoinrpc_err_t e;
+
+  json_t *batch;          /* the elements parsed so far */
+  enum bitcoinrpc_call_stream_ state;
+  size_t scan;            /* bytes of buf scanned */
+  size_t start;           /* where the current element starts */
+  size_t depth;           /* of nested objects and arrays in the element */
+  int in_elem;
+  int in_str;
+  int esc;
+  int comma;              /* an element has to follow */
+  size_t nelems;          /* parsed so far */
+
+  /*
+     If not NULL, the elements are handed over to the sink as they are
+     parsed, and not kept in the batch (see bitcoinrpc_calln_stream())
+   */
+  struct bitcoinrpc_call_sink_ *sink;
+
+  bitcoinrpc_timings_t timings;   /* of the call in progress */
+
+  /*
+     Scratch memory of the call, taken from the arena: the sizes of the
+     elements (if the client keeps statistics, nsizes > 0) and the index
+     of the ids.  The arena is kept by the handle and reset for every call.
+   */
+  struct bitcoinrpc_buf_ arena;
+  size_t *sizes;
+  size_t nsizes;
+};
+
+
+void
+bitcoinrpc_call_curl_resp_init_(struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                                struct bitcoinrpc_buf_ *buf);
+
+size_t
+bitcoinrpc_call_write_callback_(char *ptr, size_t size, size_t nmemb, void *userdata);
+
+/*
+   Set the options of a new curl handle that stay the same for every call
+   made with it: url, credentials, headers, the write callback (with
+   curl_resp) and the error buffer.  curl_resp is initialised as well;
+   free its arena, when the handle is cleaned up.
+ */
+void
+bitcoinrpc_call_setup_(bitcoinrpc_cl_t *cl, CURL *curl,
+                       struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                       char *curl_errbuf);
+
+/*
+   Serialise n methods into a JSON-RPC batch and set the curl handle
+   (prepared by bitcoinrpc_call_setup_()) to send it.  The POST data is
+   written to sendbuf, which has to be kept until the transfer is finished.
+   Received data go to recvbuf.
+ */
+BITCOINRPCEcode
+bitcoinrpc_call_prepare_(bitcoinrpc_cl_t *cl, CURL *curl, size_t n,
+                         bitcoinrpc_method_t **methods,
+                         struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                         struct bitcoinrpc_buf_ *sendbuf,
+                         struct bitcoinrpc_buf_ *recvbuf,
+                         bitcoinrpc_err_t *e);
+
+/* Monotonic clock, in seconds */
+double
+bitcoinrpc_call_now_(void);
+
+/*
+   Having the transfer with curl finished with curl_err, parse the data
+   received and store the responses in resps, with the timings of the call.
+   curl may be NULL (no transfer, e.g. in tests).
+ */
+BITCOINRPCEcode
+bitcoinrpc_call_finish_(CURL *curl, CURLcode curl_err, const char *curl_errbuf,
+                        struct bitcoinrpc_call_curl_resp_ *curl_resp,
+                        size_t n, bitcoinrpc_method_t **methods,
+                        bitcoinrpc_resp_t **resps, bitcoinrpc_err_t *e);
+
+/*
+   Abort all the asynchronous calls still in flight (without calling
+   their callbacks) and free the resources.  Called by bitcoinrpc_cl_free().
+ */
+void
+bitcoinrpc_call_async_cleanup_(bitcoinrpc_cl_t *cl);
+
+#endif /* BITCOINRPC_CALL_H_9738989f_f252_49cf_9ef8_8a6083c69b62 */
@@ -22,14 +22,23 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <curl/curl.h>
 #include <uuid/uuid.h>
 
 #include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+#include "bitcoinrpc_cache.h"
+#include "bitcoinrpc_call.h"
 #include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_flight.h"
 #include "bitcoinrpc_global.h"
+#include "bitcoinrpc_hedge.h"
+#include "bitcoinrpc_limit.h"
+#include "bitcoinrpc_node.h"
+#include "bitcoinrpc_stats.h"
 
 
 /*
@@ -41,29 +50,265 @@
            cl->addr, cl->port);
 
 
-/* ------------------------------------------------------------------------ */
+static struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_init_(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_cl_conn_ *conn = bitcoinrpc_global_allocfunc(sizeof *conn);
 
-bitcoinrpc_cl_t*
-bitcoinrpc_cl_init(void)
+  if (NULL == conn)
+    return NULL;
+
+  conn->curl = curl_easy_init();
+  if (NULL == conn->curl)
+    {
+      bitcoinrpc_global_freefunc(conn);
+      return NULL;
+    }
+  bitcoinrpc_call_setup_(cl, conn->curl, &conn->curl_resp, conn->curl_errbuf);
+  if (NULL != cl->curlsh)
+    curl_easy_setopt(conn->curl, CURLOPT_SHARE, cl->curlsh);
+  bitcoinrpc_buf_init_(&conn->sendbuf);
+  bitcoinrpc_buf_init_(&conn->recvbuf);
+  conn->curlm = NULL;
+  conn->cl = cl;
+  conn->next = NULL;
+  conn->next_all = NULL;
+
+  return conn;
+}
+
+
+static void
+bitcoinrpc_cl_conn_free_(struct bitcoinrpc_cl_conn_ *conn)
 {
-  return bitcoinrpc_cl_init_params(BITCOINRPC_USER_DEFAULT,
-                                   BITCOINRPC_PASS_DEFAULT,
-                                   BITCOINRPC_ADDR_DEFAULT,
-                                   BITCOINRPC_PORT_DEFAULT);
+  if (NULL != conn->curlm)
+    curl_multi_cleanup(conn->curlm);
+  curl_easy_cleanup(conn->curl);
+  bitcoinrpc_buf_free_(&conn->curl_resp.arena);
+  bitcoinrpc_buf_free_(&conn->sendbuf);
+  bitcoinrpc_buf_free_(&conn->recvbuf);
+  bitcoinrpc_global_freefunc(conn);
+}
+
+
+/* Put conn on the list of idle connections */
+static void
+bitcoinrpc_cl_conn_idle_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_cl_conn_ *conn)
+{
+  pthread_mutex_lock(&cl->pool_lock);
+  conn->next = cl->pool_idle;
+  cl->pool_idle = conn;
+  pthread_cond_signal(&cl->pool_cond);
+  pthread_mutex_unlock(&cl->pool_lock);
+}
+
+
+/* A thread exits: its connection can be taken over by another one */
+static void
+bitcoinrpc_cl_thread_exit_(void *ptr)
+{
+  struct bitcoinrpc_cl_conn_ *conn = (struct bitcoinrpc_cl_conn_*)ptr;
+
+  bitcoinrpc_cl_conn_idle_(conn->cl, conn);
+}
+
+
+static void
+bitcoinrpc_cl_share_lock_(CURL *curl, curl_lock_data data,
+                          curl_lock_access access, void *userptr)
+{
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)userptr;
+
+  (void)curl;
+  (void)access;
+  pthread_mutex_lock(&cl->share_lock[data]);
+}
+
+
+static void
+bitcoinrpc_cl_share_unlock_(CURL *curl, curl_lock_data data, void *userptr)
+{
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)userptr;
+
+  (void)curl;
+  pthread_mutex_unlock(&cl->share_lock[data]);
+}
+
+
+/* Set up the share handle and the per-thread connections */
+static BITCOINRPCEcode
+bitcoinrpc_cl_init_threadsafe_(bitcoinrpc_cl_t *cl)
+{
+  int i;
+
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    {
+      if (pthread_mutex_init(&cl->share_lock[i], NULL) != 0)
+        {
+          while (--i >= 0)
+            pthread_mutex_destroy(&cl->share_lock[i]);
+          return BITCOINRPCE_ERR;
+        }
+    }
+
+  if (pthread_key_create(&cl->thread_conn, bitcoinrpc_cl_thread_exit_) != 0)
+    goto err_key;
+
+  cl->curlsh = curl_share_init();
+  if (NULL == cl->curlsh)
+    goto err_share;
+
+  curl_share_setopt(cl->curlsh, CURLSHOPT_LOCKFUNC, bitcoinrpc_cl_share_lock_);
+  curl_share_setopt(cl->curlsh, CURLSHOPT_UNLOCKFUNC, bitcoinrpc_cl_share_unlock_);
+  curl_share_setopt(cl->curlsh, CURLSHOPT_USERDATA, cl);
+  curl_share_setopt(cl->curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(cl->curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  if (curl_share_setopt(cl->curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT)
+      != CURLSHE_OK)
+    {
+      curl_share_cleanup(cl->curlsh);
+      cl->curlsh = NULL;
+      goto err_share;
+    }
+
+  return BITCOINRPCE_OK;
+
+err_share:
+  pthread_key_delete(cl->thread_conn);
+err_key:
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    pthread_mutex_destroy(&cl->share_lock[i]);
+  return BITCOINRPCE_CURLE;
+}
+
+
+/*
+   Lease a connection; if all of them are busy, wait or give up.  In the
+   thread-safe mode, the one of the calling thread, unless told otherwise.
+ */
+static struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_lease_(bitcoinrpc_cl_t *cl, int wait, int pooled)
+{
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+
+  if (NULL != cl->curlsh && !pooled)
+    {
+      conn = pthread_getspecific(cl->thread_conn);
+      if (NULL != conn)
+        return conn;
+    }
+
+  pthread_mutex_lock(&cl->pool_lock);
+  while (NULL == cl->pool_idle && cl->pool_size >= cl->pool_max)
+    {
+      if (!wait)
+        {
+          pthread_mutex_unlock(&cl->pool_lock);
+          return NULL;
+        }
+      pthread_cond_wait(&cl->pool_cond, &cl->pool_lock);
+    }
+
+  if (NULL != cl->pool_idle)
+    {
+      conn = cl->pool_idle;
+      cl->pool_idle = conn->next;
+    }
+  else
+    {
+      conn = bitcoinrpc_cl_conn_init_(cl);
+      if (NULL != conn)
+        {
+          conn->next_all = cl->pool_all;
+          cl->pool_all = conn;
+          cl->pool_size++;
+        }
+    }
+  pthread_mutex_unlock(&cl->pool_lock);
+
+  if (NULL != cl->curlsh && !pooled && NULL != conn)
+    pthread_setspecific(cl->thread_conn, conn);
+
+  return conn;
+}
+
+
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_get_(bitcoinrpc_cl_t *cl)
+{
+  return bitcoinrpc_cl_conn_lease_(cl, 1, 0);
+}
+
+
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_tryget_(bitcoinrpc_cl_t *cl)
+{
+  return bitcoinrpc_cl_conn_lease_(cl, 0, 0);
+}
+
+
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_borrow_(bitcoinrpc_cl_t *cl, int wait)
+{
+  return bitcoinrpc_cl_conn_lease_(cl, wait, 1);
+}
+
+
+CURLM *
+bitcoinrpc_cl_conn_multi_(struct bitcoinrpc_cl_conn_ *conn)
+{
+  if (NULL == conn->curlm)
+    conn->curlm = curl_multi_init();
+
+  return conn->curlm;
+}
+
+
+void
+bitcoinrpc_cl_conn_put_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_cl_conn_ *conn)
+{
+  /* the thread keeps its connection */
+  if (NULL != cl->curlsh)
+    return;
+
+  bitcoinrpc_cl_conn_idle_(cl, conn);
+}
+
+
+void
+bitcoinrpc_cl_conn_return_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_cl_conn_ *conn)
+{
+  bitcoinrpc_cl_conn_idle_(cl, conn);
+}
+
+
+/* Report why a new client cannot be initialised, if asked to */
+static bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_fail_(BITCOINRPCEcode *ecode, BITCOINRPCEcode code)
+{
+  if (NULL != ecode)
+    *ecode = code;
+  return NULL;
 }
 
 
 bitcoinrpc_cl_t*
-bitcoinrpc_cl_init_params(const char* user, const char* pass,
-                          const char* addr, const unsigned int port)
+bitcoinrpc_cl_init_(const char* user, const char* pass,
+                    const char* addr, const unsigned int port,
+                    size_t max_conns, int threadsafe, BITCOINRPCEcode *ecode)
 {
-  if (NULL == user || NULL == pass || NULL == addr || port <= 0 || port > 65535)
-    return NULL;
+  struct bitcoinrpc_cl_conn_ *conn = NULL;
+  struct curl_slist *headers = NULL;
+  struct bitcoinrpc_global_scope_ scope;
+
+  if (NULL == user || NULL == pass || NULL == addr || port <= 0 || port > 65535
+      || max_conns == 0)
+    return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ARG);
 
   bitcoinrpc_cl_t *cl = bitcoinrpc_global_allocfunc(sizeof *cl);
 
   if (NULL == cl)
-    return NULL;
+    return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ALLOC);
 
   /* Initialise all the elemets of cl */
   memset(cl->uuid_str, 0, 37);
@@ -72,8 +317,32 @@ bitcoinrpc_cl_init_params(const char* user, const char* pass,
   memset(cl->addr, 0, BITCOINRPC_PARAM_MAXLEN);
   cl->port = 0;
   memset(cl->url, 0, BITCOINRPC_URL_MAXLEN);
-  cl->curl = NULL;
   cl->curl_headers = NULL;
+  cl->idmode = BITCOINRPC_ID_UUID;
+  cl->last_id = 0;
+  cl->pool_idle = NULL;
+  cl->pool_all = NULL;
+  cl->pool_size = 0;
+  cl->pool_max = max_conns;
+  cl->curlsh = NULL;
+  cl->curlm = NULL;
+  cl->async_active = NULL;
+  cl->async_free = NULL;
+  cl->async_pending = 0;
+  cl->async_maxconn = 0;
+  cl->event_socket_cb = NULL;
+  cl->event_timer_cb = NULL;
+  cl->event_userdata = NULL;
+  cl->stats = NULL;
+  cl->cache = NULL;
+  cl->flight = NULL;
+  cl->nodes = NULL;
+  cl->hedge = NULL;
+  cl->limit = NULL;
+  cl->account = bitcoinrpc_global_account_new_();
+  cl->call_memlimit = 0;
+  cl->chunk_size = 0;
+  cl->chunk_inflight = 0;
   cl->legacy_ptr_4f1af859_c918_484a_b3f6_9fe51235a3a0 = NULL;
 
   uuid_generate_random(cl->uuid);
@@ -88,35 +357,147 @@ bitcoinrpc_cl_init_params(const char* user, const char* pass,
 
   bitcoinrpc_cl_update_url_(cl);
 
-  cl->curl = curl_easy_init();
-  if (NULL == cl->curl)
+  cl->curl_headers = curl_slist_append(cl->curl_headers, "content-type: text/plain;");
+  if (NULL == cl->curl_headers)
     {
+      bitcoinrpc_global_account_release_(cl->account);
       bitcoinrpc_global_freefunc(cl);
-      return NULL;
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ALLOC);
     }
 
-  cl->curl_headers = curl_slist_append(cl->curl_headers, "content-type: text/plain;");
-  if (NULL == cl->curl_headers)
+  /* do not wait for "100 Continue" before sending a big batch */
+  headers = curl_slist_append(cl->curl_headers, "Expect:");
+  if (NULL == headers)
     {
+      curl_slist_free_all(cl->curl_headers);
+      bitcoinrpc_global_account_release_(cl->account);
       bitcoinrpc_global_freefunc(cl);
-      return NULL;
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ALLOC);
+    }
+  cl->curl_headers = headers;
+
+  if (pthread_mutex_init(&cl->pool_lock, NULL) != 0)
+    {
+      curl_slist_free_all(cl->curl_headers);
+      bitcoinrpc_global_account_release_(cl->account);
+      bitcoinrpc_global_freefunc(cl);
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ERR);
+    }
+  if (pthread_cond_init(&cl->pool_cond, NULL) != 0)
+    {
+      pthread_mutex_destroy(&cl->pool_lock);
+      curl_slist_free_all(cl->curl_headers);
+      bitcoinrpc_global_account_release_(cl->account);
+      bitcoinrpc_global_freefunc(cl);
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_ERR);
     }
 
-  curl_easy_setopt(cl->curl, CURLOPT_HTTPHEADER, cl->curl_headers);
+  if (threadsafe && bitcoinrpc_cl_init_threadsafe_(cl) != BITCOINRPCE_OK)
+    {
+      pthread_cond_destroy(&cl->pool_cond);
+      pthread_mutex_destroy(&cl->pool_lock);
+      curl_slist_free_all(cl->curl_headers);
+      bitcoinrpc_global_account_release_(cl->account);
+      bitcoinrpc_global_freefunc(cl);
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_CURLE);
+    }
 
+  /* open the first connection now, to report errors early */
+  bitcoinrpc_global_enter_(&scope, cl->account, NULL);
+  conn = bitcoinrpc_cl_conn_get_(cl);
+  bitcoinrpc_global_leave_(&scope);
+  if (NULL == conn)
+    {
+      bitcoinrpc_cl_free(cl);
+      return bitcoinrpc_cl_init_fail_(ecode, BITCOINRPCE_CURLE);
+    }
+  bitcoinrpc_cl_conn_put_(cl, conn);
+
+  if (NULL != ecode)
+    *ecode = BITCOINRPCE_OK;
   return cl;
 }
 
 
+/* ------------------------------------------------------------------------ */
+
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init(void)
+{
+  return bitcoinrpc_cl_init_params(BITCOINRPC_USER_DEFAULT,
+                                   BITCOINRPC_PASS_DEFAULT,
+                                   BITCOINRPC_ADDR_DEFAULT,
+                                   BITCOINRPC_PORT_DEFAULT);
+}
+
+
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_params(const char* user, const char* pass,
+                          const char* addr, const unsigned int port)
+{
+  return bitcoinrpc_cl_init_pool(user, pass, addr, port, 1);
+}
+
+
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_pool(const char* user, const char* pass,
+                        const char* addr, const unsigned int port,
+                        size_t max_conns)
+{
+  return bitcoinrpc_cl_init_(user, pass, addr, port, max_conns, 0, NULL);
+}
+
+
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_threadsafe(const char* user, const char* pass,
+                              const char* addr, const unsigned int port)
+{
+  return bitcoinrpc_cl_init_(user, pass, addr, port, SIZE_MAX, 1, NULL);
+}
+
+
 BITCOINRPCEcode
 bitcoinrpc_cl_free(bitcoinrpc_cl_t *cl)
 {
   if (NULL == cl)
     return BITCOINRPCE_ARG;
 
+  bitcoinrpc_call_async_cleanup_(cl);
+
+  /*
+     No more calls are supposed to be made by now.  In the thread-safe mode,
+     deleting the key makes the threads that are still alive forget about
+     their connections.
+   */
+  if (NULL != cl->curlsh)
+    pthread_key_delete(cl->thread_conn);
+
+  while (NULL != cl->pool_all)
+    {
+      struct bitcoinrpc_cl_conn_ *conn = cl->pool_all;
+      cl->pool_all = conn->next_all;
+      bitcoinrpc_cl_conn_free_(conn);
+    }
+  cl->pool_idle = NULL;
+  pthread_cond_destroy(&cl->pool_cond);
+  pthread_mutex_destroy(&cl->pool_lock);
+
+  if (NULL != cl->curlsh)
+    {
+      curl_share_cleanup(cl->curlsh);
+      cl->curlsh = NULL;
+      for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        pthread_mutex_destroy(&cl->share_lock[i]);
+    }
+
   curl_slist_free_all(cl->curl_headers);
-  curl_easy_cleanup(cl->curl);
-  cl->curl = NULL;
+  bitcoinrpc_stats_free_table_(cl->stats);
+  bitcoinrpc_cache_free_(cl->cache);
+  bitcoinrpc_flight_free_(cl->flight);
+  bitcoinrpc_node_free_table_(cl->nodes);
+  bitcoinrpc_hedge_free_(cl->hedge);
+  bitcoinrpc_limit_free_(cl->limit);
+  bitcoinrpc_global_account_release_(cl->account);   /* kept, if still charged */
   bitcoinrpc_global_freefunc(cl);
   cl = NULL;
 
@@ -179,3 +560,61 @@ bitcoinrpc_cl_get_url(bitcoinrpc_cl_t *cl, char *buf)
 
   return BITCOINRPCE_OK;
 }
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_idmode(bitcoinrpc_cl_t *cl, BITCOINRPC_ID idmode)
+{
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (idmode != BITCOINRPC_ID_UUID && idmode != BITCOINRPC_ID_COUNTER)
+    return BITCOINRPCE_ARG;
+
+  cl->idmode = idmode;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_memstats(bitcoinrpc_cl_t *cl, bitcoinrpc_memstats_t *memstats)
+{
+  if (NULL == cl || NULL == memstats)
+    return BITCOINRPCE_ARG;
+
+  if (NULL == cl->account)
+    return BITCOINRPCE_ERR;
+
+  bitcoinrpc_global_memstats_load_(memstats, &cl->account->m);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_call_memlimit(bitcoinrpc_cl_t *cl, size_t limit)
+{
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (!bitcoinrpc_global_accounting_)
+    return BITCOINRPCE_ERR;
+
+  cl->call_memlimit = limit;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_chunking(bitcoinrpc_cl_t *cl, size_t chunk, size_t inflight)
+{
+  if (NULL == cl || (chunk > 0 && 0 == inflight))
+    return BITCOINRPCE_ARG;
+
+  cl->chunk_size = chunk;
+  cl->chunk_inflight = inflight;
+
+  return BITCOINRPCE_OK;
+}
@@ -29,9 +29,32 @@
 #ifndef BITCOINRPC_CL_H_6b1e267b_bbce_4a84_8a18_172da32608a5
 #define BITCOINRPC_CL_H_6b1e267b_bbce_4a84_8a18_172da32608a5
 
+#include <pthread.h>
 #include <curl/curl.h>
 #include <uuid/uuid.h>
 #include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+#include "bitcoinrpc_call.h"
+#include "bitcoinrpc_global.h"
+
+/*
+   A connection of the pool used for blocking calls: a curl handle (which
+   keeps the connection alive, and its options) with its buffers for sent
+   and received data.
+   In the thread-safe mode, it is owned by a thread until the thread exits.
+ */
+struct bitcoinrpc_cl_conn_ {
+  CURL *curl;
+  struct bitcoinrpc_buf_ sendbuf;   /* kept and reused between calls */
+  struct bitcoinrpc_buf_ recvbuf;
+  struct bitcoinrpc_call_curl_resp_ curl_resp;
+  char curl_errbuf[CURL_ERROR_SIZE];
+  CURLM *curlm;                     /* for hedged calls, made on first use */
+
+  bitcoinrpc_cl_t *cl;
+  struct bitcoinrpc_cl_conn_ *next;       /* idle connections */
+  struct bitcoinrpc_cl_conn_ *next_all;   /* all the connections */
+};
 
 struct bitcoinrpc_cl {
   uuid_t uuid;
@@ -44,9 +67,66 @@ struct bitcoinrpc_cl {
 
   char url[BITCOINRPC_URL_MAXLEN];
 
-  CURL *curl;
   struct curl_slist *curl_headers;
 
+  BITCOINRPC_ID idmode;
+  json_int_t last_id;       /* BITCOINRPC_ID_COUNTER; updated atomically */
+
+  /*
+     Pool of connections for blocking calls.  Each call leases an idle
+     connection; new ones are opened on demand, up to pool_max.
+   */
+  pthread_mutex_t pool_lock;
+  pthread_cond_t pool_cond;                 /* a connection has been returned */
+  struct bitcoinrpc_cl_conn_ *pool_idle;
+  struct bitcoinrpc_cl_conn_ *pool_all;
+  size_t pool_size;                         /* connections opened so far */
+  size_t pool_max;
+
+  /*
+     Thread-safe mode (if curlsh != NULL): every thread lazily gets its own
+     connection; all of them share DNS and connection caches through curlsh.
+   */
+  CURLSH *curlsh;
+  pthread_mutex_t share_lock[CURL_LOCK_DATA_LAST];
+  pthread_key_t thread_conn;
+
+  /* asynchronous calls (see bitcoinrpc_async.c) */
+  CURLM *curlm;                           /* created on first use */
+  struct bitcoinrpc_async_ *async_active; /* transfers in flight */
+  struct bitcoinrpc_async_ *async_free;   /* finished, ready to reuse */
+  size_t async_pending;
+  size_t async_maxconn;
+  bitcoinrpc_socket_cb_t event_socket_cb;  /* event-driven mode, if set */
+  bitcoinrpc_timer_cb_t event_timer_cb;
+  void *event_userdata;
+
+  /* per-method statistics, if enabled (see bitcoinrpc_stats.c) */
+  struct bitcoinrpc_stats_table_ *stats;
+
+  /* results which do not change, if cached (see bitcoinrpc_cache.c) */
+  struct bitcoinrpc_cache_ *cache;
+
+  /* blocking calls of one method in flight, if shared (see bitcoinrpc_flight.c) */
+  struct bitcoinrpc_flight_ *flight;
+
+  /* the nodes to balance the blocking calls among, if added (see bitcoinrpc_node.c) */
+  struct bitcoinrpc_node_table_ *nodes;
+
+  /* slow calls sent to another node as well, if hedged (see bitcoinrpc_hedge.c) */
+  struct bitcoinrpc_hedge_ *hedge;
+
+  /* the most blocking calls in flight, if limited (see bitcoinrpc_limit.c) */
+  struct bitcoinrpc_limit_ *limit;
+
+  /* memory allocated on behalf of the client, if counted */
+  struct bitcoinrpc_global_account_ *account;
+  size_t call_memlimit;
+
+  /* batches of more methods are split into chunks, sent chunk_inflight at once */
+  size_t chunk_size;        /* 0, if not split */
+  size_t chunk_inflight;
+
   /*
      This is a legacy pointer. You can point to an auxilliary structure,
      if you prefer not to touch this one (e.g. not to break ABI).
@@ -54,5 +134,50 @@ struct bitcoinrpc_cl {
   void *legacy_ptr_4f1af859_c918_484a_b3f6_9fe51235a3a0;
 };
 
+/*
+   Initialise a new client, with a pool of max_conns connections,
+   or in the thread-safe mode.  Store the error code in ecode, if not NULL.
+ */
+bitcoinrpc_cl_t*
+bitcoinrpc_cl_init_(const char* user, const char* pass,
+                    const char* addr, const unsigned int port,
+                    size_t max_conns, int threadsafe, BITCOINRPCEcode *ecode);
+
+/*
+   Lease a connection from the pool; wait, if all of them are busy.
+   In the thread-safe mode, return the connection of the calling thread.
+   Return NULL in case of error.
+ */
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_get_(bitcoinrpc_cl_t *cl);
+
+/* As bitcoinrpc_cl_conn_get_(), but return NULL rather than wait */
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_tryget_(bitcoinrpc_cl_t *cl);
+
+/*
+   Lease a connection from the pool even in the thread-safe mode, for
+   a call which needs many of them at once (if not wait, return NULL
+   rather than wait).  Give it back with bitcoinrpc_cl_conn_return_().
+ */
+struct bitcoinrpc_cl_conn_ *
+bitcoinrpc_cl_conn_borrow_(bitcoinrpc_cl_t *cl, int wait);
+
+/*
+   The multi handle of the connection, to make one call with it and
+   another with a connection of a different node at the same time.
+   Return NULL in case of error.
+ */
+CURLM *
+bitcoinrpc_cl_conn_multi_(struct bitcoinrpc_cl_conn_ *conn);
+
+/* Give the connection back to the pool */
+void
+bitcoinrpc_cl_conn_put_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_cl_conn_ *conn);
+
+/* Give back a connection leased with bitcoinrpc_cl_conn_borrow_() */
+void
+bitcoinrpc_cl_conn_return_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_cl_conn_ *conn);
+
 
 #endif /* BITCOINRPC_CL_H_6b1e267b_bbce_4a84_8a18_172da32608a5 */
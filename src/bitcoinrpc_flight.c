@@ -0,0 +1,254 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Single flight.  The calls in flight are few (at most one per thread), so
+   they are kept in a list; every landing wakes up all the waiting threads.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_flight.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_method.h"
+#include "bitcoinrpc_resp.h"
+
+
+struct bitcoinrpc_flight_call_ {
+  struct bitcoinrpc_flight_call_ *next;   /* in flight */
+  size_t refs;            /* the leader and the threads waiting */
+  int landed;
+
+  bitcoinrpc_err_t e;
+  json_t *json;
+  bitcoinrpc_timings_t timings;
+  size_t bytes;
+
+  size_t hash;
+  size_t key_len;
+  char key[];
+};
+
+struct bitcoinrpc_flight_ {
+  pthread_mutex_t lock;
+  pthread_cond_t landed;
+  struct bitcoinrpc_flight_call_ *calls;
+  unsigned long long coalesced;
+};
+
+
+void
+bitcoinrpc_flight_free_(struct bitcoinrpc_flight_ *flight)
+{
+  if (NULL == flight)
+    return;
+
+  pthread_cond_destroy(&flight->landed);
+  pthread_mutex_destroy(&flight->lock);
+  bitcoinrpc_global_freefunc(flight);
+}
+
+
+/* Call with the lock held */
+static void
+bitcoinrpc_flight_release_(struct bitcoinrpc_flight_call_ *call)
+{
+  if (--call->refs > 0)
+    return;
+
+  json_decref(call->json);
+  bitcoinrpc_global_freefunc(call);
+}
+
+
+struct bitcoinrpc_flight_call_ *
+bitcoinrpc_flight_join_(struct bitcoinrpc_flight_ *flight,
+                        bitcoinrpc_method_t *method, int *leader)
+{
+  struct bitcoinrpc_flight_call_ *call = NULL;
+  char buf[BITCOINRPC_METHOD_KEYLEN];
+  char *key = NULL;
+  size_t len, hash;
+
+  key = bitcoinrpc_method_key_(method, buf, &len);
+  if (NULL == key)
+    return NULL;
+  hash = bitcoinrpc_method_key_hash_(key, len);
+
+  pthread_mutex_lock(&flight->lock);
+  for (call = flight->calls; call != NULL; call = call->next)
+    if (call->hash == hash && call->key_len == len
+        && memcmp(call->key, key, len) == 0)
+      break;
+
+  if (NULL != call)
+    {
+      call->refs++;
+      flight->coalesced++;
+      *leader = 0;
+    }
+  else
+    {
+      call = bitcoinrpc_global_allocfunc(sizeof *call + len);
+      if (NULL != call)
+        {
+          memset(call, 0, sizeof *call);
+          call->refs = 1;
+          call->hash = hash;
+          call->key_len = len;
+          memcpy(call->key, key, len);
+          call->next = flight->calls;
+          flight->calls = call;
+          *leader = 1;
+        }
+    }
+  pthread_mutex_unlock(&flight->lock);
+
+  bitcoinrpc_method_key_free_(key, buf);
+
+  return call;
+}
+
+
+void
+bitcoinrpc_flight_land_(struct bitcoinrpc_flight_ *flight,
+                        struct bitcoinrpc_flight_call_ *call,
+                        bitcoinrpc_err_t *e, bitcoinrpc_resp_t *resp)
+{
+  struct bitcoinrpc_flight_call_ **p = NULL;
+  json_t *json = NULL;
+
+  /*
+     A copy, taken before the caller of the leader gets resp back (and may
+     change it); nothing, if the call has failed (resp may hold an old one).
+   */
+  if (BITCOINRPCE_OK == e->code)
+    json = json_deep_copy(resp->json);
+
+  pthread_mutex_lock(&flight->lock);
+
+  /* new calls of the method start a new flight from now on */
+  for (p = &flight->calls; *p != call; p = &(*p)->next)
+    ;
+  *p = call->next;
+
+  call->e = *e;
+  call->json = json;
+  call->timings = resp->timings;
+  call->bytes = resp->bytes;
+  call->landed = 1;
+  pthread_cond_broadcast(&flight->landed);
+
+  bitcoinrpc_flight_release_(call);
+  pthread_mutex_unlock(&flight->lock);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_flight_wait_(struct bitcoinrpc_flight_ *flight,
+                        struct bitcoinrpc_flight_call_ *call,
+                        bitcoinrpc_err_t *e, bitcoinrpc_resp_t *resp, json_t **json)
+{
+  BITCOINRPCEcode ecode;
+
+  pthread_mutex_lock(&flight->lock);
+  while (!call->landed)
+    pthread_cond_wait(&flight->landed, &flight->lock);
+
+  ecode = call->e.code;
+  if (NULL != e)
+    *e = call->e;
+  *json = json_deep_copy(call->json);     /* every follower may change its own */
+  resp->timings = call->timings;
+  resp->bytes = call->bytes;
+
+  bitcoinrpc_flight_release_(call);
+  pthread_mutex_unlock(&flight->lock);
+
+  return ecode;
+}
+
+
+/* ------------------------------------------------------------------------  */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_single_flight(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_flight_ *flight = NULL;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->flight)
+    return BITCOINRPCE_ERR;
+
+  flight = bitcoinrpc_global_allocfunc(sizeof *flight);
+  if (NULL == flight)
+    return BITCOINRPCE_ALLOC;
+  flight->calls = NULL;
+  flight->coalesced = 0;
+  if (pthread_mutex_init(&flight->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(flight);
+      return BITCOINRPCE_ERR;
+    }
+  if (pthread_cond_init(&flight->landed, NULL) != 0)
+    {
+      pthread_mutex_destroy(&flight->lock);
+      bitcoinrpc_global_freefunc(flight);
+      return BITCOINRPCE_ERR;
+    }
+
+  if (!__sync_bool_compare_and_swap(&cl->flight, NULL, flight))
+    {
+      bitcoinrpc_flight_free_(flight);
+      return BITCOINRPCE_ERR;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_coalesced(bitcoinrpc_cl_t *cl, unsigned long long *coalesced)
+{
+  if (NULL == cl || NULL == coalesced)
+    return BITCOINRPCE_ARG;
+
+  if (NULL == cl->flight)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&cl->flight->lock);
+  *coalesced = cl->flight->coalesced;
+  pthread_mutex_unlock(&cl->flight->lock);
+
+  return BITCOINRPCE_OK;
+}
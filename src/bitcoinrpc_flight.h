@@ -0,0 +1,72 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Single flight: calls of the same method, made at the same time by many
+   threads, wait for one of them to get the response
+ */
+
+#ifndef BITCOINRPC_FLIGHT_H_8f0d6b27_c4a1_4e5b_9d36_1a7e2f84b0c9
+#define BITCOINRPC_FLIGHT_H_8f0d6b27_c4a1_4e5b_9d36_1a7e2f84b0c9
+
+#include <jansson.h>
+#include "bitcoinrpc.h"
+
+struct bitcoinrpc_flight_;
+struct bitcoinrpc_flight_call_;
+
+
+void
+bitcoinrpc_flight_free_(struct bitcoinrpc_flight_ *flight);
+
+/*
+   Join the call of the same method (see: bitcoinrpc_method_key_()) in
+   flight, or start a new one; then *leader is set and the caller has to
+   make the call and pass its outcome to bitcoinrpc_flight_land_().
+   Otherwise, call bitcoinrpc_flight_wait_().
+   Return NULL in case of error (and make the call alone).
+ */
+struct bitcoinrpc_flight_call_ *
+bitcoinrpc_flight_join_(struct bitcoinrpc_flight_ *flight,
+                        bitcoinrpc_method_t *method, int *leader);
+
+/* Share the outcome of the call with those waiting for it */
+void
+bitcoinrpc_flight_land_(struct bitcoinrpc_flight_ *flight,
+                        struct bitcoinrpc_flight_call_ *call,
+                        bitcoinrpc_err_t *e, bitcoinrpc_resp_t *resp);
+
+/*
+   Wait for the leader of the call to land it.  Copy the error of the call
+   to e and store a copy of the response of its own (a JSON-RPC object, or
+   NULL if the call has failed) in json; timings and bytes are copied to resp.
+ */
+BITCOINRPCEcode
+bitcoinrpc_flight_wait_(struct bitcoinrpc_flight_ *flight,
+                        struct bitcoinrpc_flight_call_ *call,
+                        bitcoinrpc_err_t *e, bitcoinrpc_resp_t *resp, json_t **json);
+
+#endif /* BITCOINRPC_FLIGHT_H_8f0d6b27_c4a1_4e5b_9d36_1a7e2f84b0c9 */
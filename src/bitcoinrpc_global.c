@@ -22,8 +22,11 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <curl/curl.h>
+#include <jansson.h>
 #include "bitcoinrpc.h"
 #include "bitcoinrpc_global.h"
 
@@ -47,6 +50,30 @@ void (*bitcoinrpc_global_freefunc)(void *ptr) =
   bitcoinrpc_global_freefunc_default_;
 
 
+int bitcoinrpc_global_accounting_ = 0;
+
+/* The functions set by the user, below the accounting */
+static void * (*bitcoinrpc_global_allocfunc_inner_)(size_t size) =
+  bitcoinrpc_global_allocfunc_default_;
+
+static void (*bitcoinrpc_global_freefunc_inner_)(void *ptr) =
+  bitcoinrpc_global_freefunc_default_;
+
+/* All the memory allocated by the library */
+static struct bitcoinrpc_global_account_ bitcoinrpc_global_account_all_;
+
+static __thread struct bitcoinrpc_global_scope_ bitcoinrpc_global_scope_ = { NULL, NULL };
+
+/* Precedes every block; the union keeps the block aligned as malloc() does */
+union bitcoinrpc_global_header_ {
+  struct {
+    size_t size;
+    struct bitcoinrpc_global_account_ *account;
+  } h;
+  long double align_;
+};
+
+
 BITCOINRPCEcode
 bitcoinrpc_global_init(void)
 {
@@ -104,7 +131,10 @@ bitcoinrpc_global_set_allocfunc(void * (*const f)(size_t size))
 {
   if (NULL == f)
     return BITCOINRPCE_ARG;
-  bitcoinrpc_global_allocfunc = f;
+  if (bitcoinrpc_global_accounting_)
+    bitcoinrpc_global_allocfunc_inner_ = f;
+  else
+    bitcoinrpc_global_allocfunc = f;
 
   return BITCOINRPCE_OK;
 }
@@ -115,7 +145,222 @@ bitcoinrpc_global_set_freefunc(void(*const f) (void *ptr))
 {
   if (NULL == f)
     return BITCOINRPCE_ARG;
-  bitcoinrpc_global_freefunc = f;
+  if (bitcoinrpc_global_accounting_)
+    bitcoinrpc_global_freefunc_inner_ = f;
+  else
+    bitcoinrpc_global_freefunc = f;
 
   return BITCOINRPCE_OK;
 }
+
+
+/* Add size (may be negative) to the counters m, shared by many threads */
+static void
+bitcoinrpc_global_charge_(bitcoinrpc_memstats_t *m, long long size)
+{
+  long long in_use = __sync_add_and_fetch(&m->in_use, size);
+  long long peak;
+
+  if (size < 0)
+    return;
+
+  __sync_add_and_fetch(&m->allocs, 1);
+  __sync_add_and_fetch(&m->bytes, (unsigned long long)size);
+  do
+    peak = m->peak;
+  while (in_use > peak && !__sync_bool_compare_and_swap(&m->peak, peak, in_use));
+}
+
+
+/* The same for the counters of the calling thread */
+static void
+bitcoinrpc_global_track_(bitcoinrpc_memstats_t *m, long long size)
+{
+  m->in_use += size;
+  if (size < 0)
+    return;
+
+  m->allocs++;
+  m->bytes += (unsigned long long)size;
+  if (m->in_use > m->peak)
+    m->peak = m->in_use;
+}
+
+
+static void *
+bitcoinrpc_global_alloc_(size_t size, int limited)
+{
+  struct bitcoinrpc_global_scope_ *s = &bitcoinrpc_global_scope_;
+  union bitcoinrpc_global_header_ *hdr = NULL;
+
+  if (size > SIZE_MAX / 2)
+    return NULL;
+  if (limited && NULL != s->tracker && s->tracker->limit > 0
+      && s->tracker->m.in_use + (long long)size > (long long)s->tracker->limit)
+    return NULL;
+
+  hdr = bitcoinrpc_global_allocfunc_inner_(sizeof *hdr + size);
+  if (NULL == hdr)
+    return NULL;
+  hdr->h.size = size;
+  hdr->h.account = s->account;
+
+  bitcoinrpc_global_charge_(&bitcoinrpc_global_account_all_.m, (long long)size);
+  if (NULL != s->account)
+    {
+      __sync_add_and_fetch(&s->account->refs, 1);
+      bitcoinrpc_global_charge_(&s->account->m, (long long)size);
+    }
+  if (NULL != s->tracker)
+    bitcoinrpc_global_track_(&s->tracker->m, (long long)size);
+
+  return hdr + 1;
+}
+
+
+static void *
+bitcoinrpc_global_allocfunc_account_(size_t size)
+{
+  return bitcoinrpc_global_alloc_(size, 1);
+}
+
+
+/*
+   The limit of a call does not apply to jansson: its lexer (as of 2.14)
+   ignores failed allocations and may then write past the end of a buffer.
+   The limit is checked after each piece of the response has been parsed.
+ */
+static void *
+bitcoinrpc_global_allocfunc_json_(size_t size)
+{
+  return bitcoinrpc_global_alloc_(size, 0);
+}
+
+
+static void
+bitcoinrpc_global_freefunc_account_(void *ptr)
+{
+  struct bitcoinrpc_global_scope_ *s = &bitcoinrpc_global_scope_;
+  union bitcoinrpc_global_header_ *hdr = NULL;
+  long long size;
+
+  if (NULL == ptr)
+    return;
+
+  hdr = (union bitcoinrpc_global_header_ *)ptr - 1;
+  size = (long long)hdr->h.size;
+
+  bitcoinrpc_global_charge_(&bitcoinrpc_global_account_all_.m, -size);
+  if (NULL != hdr->h.account)
+    {
+      bitcoinrpc_global_charge_(&hdr->h.account->m, -size);
+      bitcoinrpc_global_account_release_(hdr->h.account);
+    }
+  if (NULL != s->tracker)
+    bitcoinrpc_global_track_(&s->tracker->m, -size);
+
+  bitcoinrpc_global_freefunc_inner_(hdr);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_global_enable_accounting(int jansson)
+{
+  if (bitcoinrpc_global_accounting_)
+    return BITCOINRPCE_ERR;
+
+  bitcoinrpc_global_allocfunc_inner_ = bitcoinrpc_global_allocfunc;
+  bitcoinrpc_global_freefunc_inner_ = bitcoinrpc_global_freefunc;
+  bitcoinrpc_global_allocfunc = bitcoinrpc_global_allocfunc_account_;
+  bitcoinrpc_global_freefunc = bitcoinrpc_global_freefunc_account_;
+  memset(&bitcoinrpc_global_account_all_, 0, sizeof bitcoinrpc_global_account_all_);
+  bitcoinrpc_global_accounting_ = 1;
+
+  if (jansson)
+    json_set_alloc_funcs(bitcoinrpc_global_allocfunc_json_,
+                         bitcoinrpc_global_freefunc_account_);
+
+  return BITCOINRPCE_OK;
+}
+
+
+int
+bitcoinrpc_global_over_limit_(void)
+{
+  struct bitcoinrpc_global_tracker_ *t = bitcoinrpc_global_scope_.tracker;
+
+  return NULL != t && t->limit > 0 && t->m.in_use > (long long)t->limit;
+}
+
+
+void
+bitcoinrpc_global_memstats_load_(bitcoinrpc_memstats_t *dst, bitcoinrpc_memstats_t *src)
+{
+  dst->allocs = __sync_fetch_and_add(&src->allocs, 0);
+  dst->bytes = __sync_fetch_and_add(&src->bytes, 0);
+  dst->in_use = __sync_fetch_and_add(&src->in_use, 0);
+  dst->peak = __sync_fetch_and_add(&src->peak, 0);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_global_get_memstats(bitcoinrpc_memstats_t *memstats)
+{
+  if (NULL == memstats)
+    return BITCOINRPCE_ARG;
+
+  if (!bitcoinrpc_global_accounting_)
+    return BITCOINRPCE_ERR;
+
+  bitcoinrpc_global_memstats_load_(memstats, &bitcoinrpc_global_account_all_.m);
+
+  return BITCOINRPCE_OK;
+}
+
+
+struct bitcoinrpc_global_account_ *
+bitcoinrpc_global_account_new_(void)
+{
+  struct bitcoinrpc_global_account_ *a = NULL;
+
+  if (!bitcoinrpc_global_accounting_)
+    return NULL;
+
+  /* not charged to anything */
+  a = bitcoinrpc_global_allocfunc_inner_(sizeof *a);
+  if (NULL == a)
+    return NULL;
+  memset(a, 0, sizeof *a);
+  a->refs = 1;
+
+  return a;
+}
+
+
+void
+bitcoinrpc_global_account_release_(struct bitcoinrpc_global_account_ *account)
+{
+  if (NULL == account)
+    return;
+
+  if (__sync_sub_and_fetch(&account->refs, 1) == 0)
+    bitcoinrpc_global_freefunc_inner_(account);
+}
+
+
+void
+bitcoinrpc_global_enter_(struct bitcoinrpc_global_scope_ *prev,
+                         struct bitcoinrpc_global_account_ *account,
+                         struct bitcoinrpc_global_tracker_ *tracker)
+{
+  *prev = bitcoinrpc_global_scope_;
+  bitcoinrpc_global_scope_.account = account;
+  bitcoinrpc_global_scope_.tracker = tracker;
+}
+
+
+void
+bitcoinrpc_global_leave_(const struct bitcoinrpc_global_scope_ *prev)
+{
+  bitcoinrpc_global_scope_ = *prev;
+}
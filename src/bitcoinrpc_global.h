@@ -62,4 +62,62 @@ extern void * (*bitcoinrpc_global_allocfunc)(size_t size);
 extern void (* bitcoinrpc_global_freefunc)(void *ptr);
 
 
+/*
+   Accounting of allocations (see: bitcoinrpc_global_enable_accounting()).
+   Every block is preceded by a header with its size and the account
+   it is charged to, so it can be uncharged when freed.
+ */
+extern int bitcoinrpc_global_accounting_;
+
+/*
+   Memory charged to a client.  It is freed when the client has released
+   it and the last block charged to it has been freed, so it may outlive
+   the client.
+ */
+struct bitcoinrpc_global_account_ {
+  bitcoinrpc_memstats_t m;      /* updated atomically */
+  size_t refs;                  /* blocks not freed yet + 1 for the client */
+};
+
+/* Memory allocated during a blocking call, by the calling thread */
+struct bitcoinrpc_global_tracker_ {
+  bitcoinrpc_memstats_t m;
+  size_t limit;                 /* of in_use; 0 means no limit */
+};
+
+/* What the allocations of the calling thread are charged to */
+struct bitcoinrpc_global_scope_ {
+  struct bitcoinrpc_global_account_ *account;
+  struct bitcoinrpc_global_tracker_ *tracker;
+};
+
+/* NULL, if the allocations are not counted */
+struct bitcoinrpc_global_account_ *
+bitcoinrpc_global_account_new_(void);
+
+void
+bitcoinrpc_global_account_release_(struct bitcoinrpc_global_account_ *account);
+
+/*
+   Charge the allocations of the calling thread to account and tracker
+   (either may be NULL), until bitcoinrpc_global_leave_() restores
+   the previous scope, saved in prev.
+ */
+void
+bitcoinrpc_global_enter_(struct bitcoinrpc_global_scope_ *prev,
+                         struct bitcoinrpc_global_account_ *account,
+                         struct bitcoinrpc_global_tracker_ *tracker);
+
+void
+bitcoinrpc_global_leave_(const struct bitcoinrpc_global_scope_ *prev);
+
+/* Whether the call of the calling thread holds more memory than its limit */
+int
+bitcoinrpc_global_over_limit_(void);
+
+/* Atomically read the counters of src */
+void
+bitcoinrpc_global_memstats_load_(bitcoinrpc_memstats_t *dst, bitcoinrpc_memstats_t *src);
+
+
 #endif /* BITCOINRPC_GLOBAL_H_5fe378f8_8280_4f1c_a3c3_7c84da05eff5 */
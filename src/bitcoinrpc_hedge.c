@@ -0,0 +1,237 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Hedged calls.  The delay is the latency percentile q of the method, taken
+   from the statistics of the client, and looked up again every
+   BITCOINRPC_HEDGE_REFRESH_ calls of it; until there are as many calls
+   recorded, and whenever it is shorter, the least delay is used.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_hedge.h"
+#include "bitcoinrpc_method.h"
+#include "bitcoinrpc_node.h"
+#include "bitcoinrpc_stats.h"
+
+
+#define BITCOINRPC_HEDGE_REFRESH_ 32
+
+struct bitcoinrpc_hedge_method_ {
+  double delay;             /* 0, if not known yet */
+  unsigned long long calls; /* hedged, or not */
+};
+
+struct bitcoinrpc_hedge_ {
+  pthread_mutex_t lock;
+  double q;
+  double delay;             /* the least one */
+  unsigned long long hedged;
+  unsigned long long won;
+  struct bitcoinrpc_hedge_method_ by_method[BITCOINRPC_STATS_METHODS_];
+};
+
+
+void
+bitcoinrpc_hedge_free_(struct bitcoinrpc_hedge_ *hedge)
+{
+  if (NULL == hedge)
+    return;
+
+  pthread_mutex_destroy(&hedge->lock);
+  bitcoinrpc_global_freefunc(hedge);
+}
+
+
+/*
+   The methods which only read the state of the server (in the categories
+   of the blockchain, control, mining, network, raw transactions and
+   utility), so that sending them twice does no harm.  The wallet is left
+   out: it is not replicated among the nodes.
+ */
+static int
+bitcoinrpc_hedge_method_(BITCOINRPC_METHOD m)
+{
+  switch (m)
+    {
+    case BITCOINRPC_METHOD_GETBESTBLOCKHASH:
+    case BITCOINRPC_METHOD_GETBLOCK:
+    case BITCOINRPC_METHOD_GETBLOCKCHAININFO:
+    case BITCOINRPC_METHOD_GETBLOCKCOUNT:
+    case BITCOINRPC_METHOD_GETBLOCKHASH:
+    case BITCOINRPC_METHOD_GETCHAINTIPS:
+    case BITCOINRPC_METHOD_GETDIFFICULTY:
+    case BITCOINRPC_METHOD_GETMEMPOOLINFO:
+    case BITCOINRPC_METHOD_GETRAWMEMPOOL:
+    case BITCOINRPC_METHOD_GETTXOUT:
+    case BITCOINRPC_METHOD_GETTXOUTPROOF:
+    case BITCOINRPC_METHOD_GETTXOUTSETINFO:
+    case BITCOINRPC_METHOD_VERIFYTXOUTPROOF:
+    case BITCOINRPC_METHOD_GETINFO:
+    case BITCOINRPC_METHOD_HELP:
+    case BITCOINRPC_METHOD_GETMININGINFO:
+    case BITCOINRPC_METHOD_GETNETWORKHASHPS:
+    case BITCOINRPC_METHOD_GETADDEDNODEINFO:
+    case BITCOINRPC_METHOD_GETCONNECTIONCOUNT:
+    case BITCOINRPC_METHOD_GETNETTOTALS:
+    case BITCOINRPC_METHOD_GETNETWORKINFO:
+    case BITCOINRPC_METHOD_GETPEERINFO:
+    case BITCOINRPC_METHOD_DECODERAWTRANSACTION:
+    case BITCOINRPC_METHOD_DECODESCRIPT:
+    case BITCOINRPC_METHOD_GETRAWTRANSACTION:
+    case BITCOINRPC_METHOD_CREATEMULTISIG:
+    case BITCOINRPC_METHOD_ESTIMATEFEE:
+    case BITCOINRPC_METHOD_ESTIMATEPRIORITY:
+    case BITCOINRPC_METHOD_VALIDATEADDRESS:
+    case BITCOINRPC_METHOD_VERIFYMESSAGE:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+
+/* Call with the lock held */
+static double
+bitcoinrpc_hedge_method_delay_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_hedge_ *hedge,
+                               BITCOINRPC_METHOD m)
+{
+  struct bitcoinrpc_hedge_method_ *hm = &hedge->by_method[m];
+  unsigned long long recorded = 0;
+  double p;
+
+  if (0 == hm->calls++ % BITCOINRPC_HEDGE_REFRESH_)
+    {
+      p = bitcoinrpc_stats_method_percentile_(cl, m, hedge->q, &recorded);
+      hm->delay = (recorded >= BITCOINRPC_HEDGE_REFRESH_ && p > 0) ? p : 0;
+    }
+
+  return hm->delay;
+}
+
+
+double
+bitcoinrpc_hedge_delay_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods)
+{
+  struct bitcoinrpc_hedge_ *hedge = cl->hedge;
+  double delay, d;
+
+  /* the nodes are added before the client is shared */
+  if (NULL == hedge || NULL == cl->nodes || cl->nodes->n < 2)
+    return -1.0;
+
+  for (size_t i = 0; i < n; i++)
+    if (!bitcoinrpc_hedge_method_(methods[i]->m))
+      return -1.0;
+
+  pthread_mutex_lock(&hedge->lock);
+  delay = hedge->delay;
+  for (size_t i = 0; i < n; i++)
+    {
+      d = bitcoinrpc_hedge_method_delay_(cl, hedge, methods[i]->m);
+      if (d > delay)
+        delay = d;
+    }
+  pthread_mutex_unlock(&hedge->lock);
+
+  return delay;
+}
+
+
+void
+bitcoinrpc_hedge_count_(struct bitcoinrpc_hedge_ *hedge, int won)
+{
+  pthread_mutex_lock(&hedge->lock);
+  hedge->hedged++;
+  if (won)
+    hedge->won++;
+  pthread_mutex_unlock(&hedge->lock);
+}
+
+
+/* ------------------------------------------------------------------------ */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_hedging(bitcoinrpc_cl_t *cl, double q, double delay)
+{
+  struct bitcoinrpc_hedge_ *hedge = NULL;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl || !(q > 0 && q < 1) || !(delay >= 0))
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->hedge)
+    return BITCOINRPCE_ERR;
+
+  /* the latencies of the methods are taken from there */
+  ecode = bitcoinrpc_cl_enable_stats(cl);
+  if (ecode != BITCOINRPCE_OK)
+    return ecode;
+
+  hedge = bitcoinrpc_global_allocfunc(sizeof *hedge);
+  if (NULL == hedge)
+    return BITCOINRPCE_ALLOC;
+  memset(hedge, 0, sizeof *hedge);
+  hedge->q = q;
+  hedge->delay = delay;
+  if (pthread_mutex_init(&hedge->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(hedge);
+      return BITCOINRPCE_ERR;
+    }
+
+  if (!__sync_bool_compare_and_swap(&cl->hedge, NULL, hedge))
+    {
+      bitcoinrpc_hedge_free_(hedge);
+      return BITCOINRPCE_ERR;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_hedged(bitcoinrpc_cl_t *cl, unsigned long long *hedged,
+                         unsigned long long *won)
+{
+  if (NULL == cl || NULL == hedged || NULL == won)
+    return BITCOINRPCE_ARG;
+
+  if (NULL == cl->hedge)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&cl->hedge->lock);
+  *hedged = cl->hedge->hedged;
+  *won = cl->hedge->won;
+  pthread_mutex_unlock(&cl->hedge->lock);
+
+  return BITCOINRPCE_OK;
+}
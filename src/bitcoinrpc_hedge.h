@@ -0,0 +1,56 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Hedged calls: a slow call of read-only methods is sent to another node
+   as well, and the first response is taken
+ */
+
+#ifndef BITCOINRPC_HEDGE_H_3e7c0a59_d2b8_4f16_a4e3_6b91c5d078fa
+#define BITCOINRPC_HEDGE_H_3e7c0a59_d2b8_4f16_a4e3_6b91c5d078fa
+
+#include "bitcoinrpc.h"
+
+struct bitcoinrpc_hedge_;
+
+
+void
+bitcoinrpc_hedge_free_(struct bitcoinrpc_hedge_ *hedge);
+
+/*
+   How long to wait (in seconds) before the call of n methods is sent to
+   another node too.  Return -1, if the call is not to be hedged: hedging is
+   not enabled, the client has no other node, or a method may change the
+   state of the server.
+ */
+double
+bitcoinrpc_hedge_delay_(bitcoinrpc_cl_t *cl, size_t n, bitcoinrpc_method_t **methods);
+
+/* Count a call which has been hedged, and whether the other node has won */
+void
+bitcoinrpc_hedge_count_(struct bitcoinrpc_hedge_ *hedge, int won);
+
+#endif /* BITCOINRPC_HEDGE_H_3e7c0a59_d2b8_4f16_a4e3_6b91c5d078fa */
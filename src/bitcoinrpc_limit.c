@@ -0,0 +1,229 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Adaptive concurrency limit (AIMD).  The limit grows by one with every
+   call which has used all of it (slow start), then by one per limit calls;
+   it is halved when the server refuses a call (HTTP 503: its work queue is
+   full), or when the latency of the calls of late (a short-term average)
+   gets BITCOINRPC_LIMIT_TOLERANCE_ times the usual one (a long-term
+   average): the server is queueing.  It is cut at most once per latency,
+   since the calls in flight together see the same congestion.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_call.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_limit.h"
+
+
+#define BITCOINRPC_LIMIT_BACKOFF_ 0.5
+#define BITCOINRPC_LIMIT_TOLERANCE_ 2.0
+
+/* The weights of a new latency in the averages */
+#define BITCOINRPC_LIMIT_FAST_ 0.2
+#define BITCOINRPC_LIMIT_SLOW_ 0.02
+
+struct bitcoinrpc_limit_ {
+  pthread_mutex_t lock;
+  pthread_cond_t room;      /* a call has ended */
+  double limit;
+  size_t min;
+  size_t max;
+  size_t queue;             /* the most calls waiting */
+  size_t inflight;
+  size_t waiting;
+  int slow_start;
+  double fast;              /* averages of the latency; 0 until the first call */
+  double slow;
+  double cut_at;            /* see: bitcoinrpc_call_now_() */
+  unsigned long long overloads;
+  unsigned long long rejected;
+};
+
+
+void
+bitcoinrpc_limit_free_(struct bitcoinrpc_limit_ *limit)
+{
+  if (NULL == limit)
+    return;
+
+  pthread_cond_destroy(&limit->room);
+  pthread_mutex_destroy(&limit->lock);
+  bitcoinrpc_global_freefunc(limit);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_limit_acquire_(struct bitcoinrpc_limit_ *limit, int wait)
+{
+  pthread_mutex_lock(&limit->lock);
+  if (limit->inflight >= (size_t)limit->limit)
+    {
+      if (!wait || limit->waiting >= limit->queue)
+        {
+          if (wait)
+            limit->rejected++;
+          pthread_mutex_unlock(&limit->lock);
+          return BITCOINRPCE_ERR;
+        }
+      limit->waiting++;
+      while (limit->inflight >= (size_t)limit->limit)
+        pthread_cond_wait(&limit->room, &limit->lock);
+      limit->waiting--;
+    }
+  limit->inflight++;
+  pthread_mutex_unlock(&limit->lock);
+
+  return BITCOINRPCE_OK;
+}
+
+
+/* Call with the lock held */
+static void
+bitcoinrpc_limit_cut_(struct bitcoinrpc_limit_ *limit)
+{
+  double now = bitcoinrpc_call_now_();
+
+  if (now - limit->cut_at < limit->fast)
+    return;
+
+  limit->limit *= BITCOINRPC_LIMIT_BACKOFF_;
+  if (limit->limit < limit->min)
+    limit->limit = limit->min;
+  limit->slow_start = 0;
+  limit->cut_at = now;
+}
+
+
+void
+bitcoinrpc_limit_release_(struct bitcoinrpc_limit_ *limit, BITCOINRPCEcode code,
+                          double seconds)
+{
+  pthread_mutex_lock(&limit->lock);
+  limit->inflight--;
+
+  if (BITCOINRPCE_BUSY == code)
+    {
+      limit->overloads++;
+      bitcoinrpc_limit_cut_(limit);
+    }
+  else if (BITCOINRPCE_OK == code)
+    {
+      if (0 == limit->slow)
+        {
+          limit->fast = seconds;
+          limit->slow = seconds;
+        }
+      limit->fast += BITCOINRPC_LIMIT_FAST_ * (seconds - limit->fast);
+      limit->slow += BITCOINRPC_LIMIT_SLOW_ * (seconds - limit->slow);
+
+      if (limit->fast > BITCOINRPC_LIMIT_TOLERANCE_ * limit->slow)
+        bitcoinrpc_limit_cut_(limit);
+      else if (limit->inflight + 1 >= (size_t)limit->limit)
+        {
+          /* the limit has been reached, and the server has kept up */
+          limit->limit += limit->slow_start ? 1.0 : 1.0 / limit->limit;
+          if (limit->limit > limit->max)
+            limit->limit = limit->max;
+        }
+    }
+
+  pthread_cond_broadcast(&limit->room);
+  pthread_mutex_unlock(&limit->lock);
+}
+
+
+/* ------------------------------------------------------------------------ */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_limit(bitcoinrpc_cl_t *cl, size_t min, size_t max, size_t queue)
+{
+  struct bitcoinrpc_limit_ *limit = NULL;
+
+  if (NULL == cl || 0 == min || max < min)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->limit)
+    return BITCOINRPCE_ERR;
+
+  limit = bitcoinrpc_global_allocfunc(sizeof *limit);
+  if (NULL == limit)
+    return BITCOINRPCE_ALLOC;
+  memset(limit, 0, sizeof *limit);
+  limit->limit = min;
+  limit->min = min;
+  limit->max = max;
+  limit->queue = queue;
+  limit->slow_start = 1;
+  if (pthread_mutex_init(&limit->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(limit);
+      return BITCOINRPCE_ERR;
+    }
+  if (pthread_cond_init(&limit->room, NULL) != 0)
+    {
+      pthread_mutex_destroy(&limit->lock);
+      bitcoinrpc_global_freefunc(limit);
+      return BITCOINRPCE_ERR;
+    }
+
+  if (!__sync_bool_compare_and_swap(&cl->limit, NULL, limit))
+    {
+      bitcoinrpc_limit_free_(limit);
+      return BITCOINRPCE_ERR;
+    }
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_limitstats(bitcoinrpc_cl_t *cl, bitcoinrpc_limitstats_t *limitstats)
+{
+  struct bitcoinrpc_limit_ *limit = NULL;
+
+  if (NULL == cl || NULL == limitstats)
+    return BITCOINRPCE_ARG;
+
+  limit = cl->limit;
+  if (NULL == limit)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&limit->lock);
+  limitstats->limit = limit->limit;
+  limitstats->inflight = limit->inflight;
+  limitstats->waiting = limit->waiting;
+  limitstats->overloads = limit->overloads;
+  limitstats->rejected = limit->rejected;
+  pthread_mutex_unlock(&limit->lock);
+
+  return BITCOINRPCE_OK;
+}
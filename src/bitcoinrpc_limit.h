@@ -0,0 +1,65 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Adaptive limit of the blocking calls of a client in flight, so as not to
+   overflow the work queue of the server
+ */
+
+#ifndef BITCOINRPC_LIMIT_H_9b4d1f3a_70e2_4c85_b6a9_e215c8d47f03
+#define BITCOINRPC_LIMIT_H_9b4d1f3a_70e2_4c85_b6a9_e215c8d47f03
+
+#include "bitcoinrpc.h"
+
+/* How many times a call refused by the server is sent again */
+#define BITCOINRPC_LIMIT_RETRIES_ 3
+
+/* The wait before the first time (in seconds), doubled every next time */
+#define BITCOINRPC_LIMIT_RETRY_WAIT_ 0.05
+
+struct bitcoinrpc_limit_;
+
+
+void
+bitcoinrpc_limit_free_(struct bitcoinrpc_limit_ *limit);
+
+/*
+   Take a place among the calls in flight; wait, if there is none.
+   Return BITCOINRPCE_ERR, if too many calls are waiting already, or if
+   there is no place and not to wait.
+ */
+BITCOINRPCEcode
+bitcoinrpc_limit_acquire_(struct bitcoinrpc_limit_ *limit, int wait);
+
+/*
+   The call has ended with code after seconds: give its place back and
+   adjust the limit.  BITCOINRPCE_BUSY means the server has refused it.
+ */
+void
+bitcoinrpc_limit_release_(struct bitcoinrpc_limit_ *limit, BITCOINRPCEcode code,
+                          double seconds);
+
+#endif /* BITCOINRPC_LIMIT_H_9b4d1f3a_70e2_4c85_b6a9_e215c8d47f03 */
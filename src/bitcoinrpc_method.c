@@ -22,11 +22,14 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <jansson.h>
 #include <uuid/uuid.h>
 
 #include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
 #include "bitcoinrpc_global.h"
 #include "bitcoinrpc_method.h"
 
@@ -155,6 +158,15 @@ bitcoinrpc_method_st_(const BITCOINRPC_METHOD m)
     }
   return NULL;
 }
+
+
+const char *
+bitcoinrpc_method_name_(const BITCOINRPC_METHOD m)
+{
+  const struct BITCOINRPC_METHOD_struct_ *ms = bitcoinrpc_method_st_(m);
+
+  return (NULL == ms) ? NULL : ms->str;
+}
 /* ------------------------------------------------------------------------- */
 
 
@@ -164,43 +176,204 @@ bitcoinrpc_method_st_(const BITCOINRPC_METHOD m)
    Internal methods
  */
 
+/*
+   Serialise the constant part of the request once, so that a call has only
+   to copy it and append the id:
+   {"jsonrpc":"2.0","method":"getblock","params":["..."],"id":
+   JSON is dumped straight into the buffer of the method, which is reused,
+   if big enough (see: bitcoinrpc_method_reset()).  The elements of an array
+   of params are dumped one by one, to remember where each of them lies.
+ */
+#define BITCOINRPC_METHOD_PFLAGS_ (JSON_COMPACT | JSON_ENCODE_ANY)
+
+/* room left in a new post, so that a parameter may grow in place */
+#define BITCOINRPC_METHOD_POST_SLACK_ 32
+
 static BITCOINRPCEcode
-bitcoinrpc_method_make_postjson_(bitcoinrpc_method_t *method)
+bitcoinrpc_method_make_post_(bitcoinrpc_method_t *method)
 {
+  static const char head[] = "{\"jsonrpc\":\"2.0\",\"method\":";
+  static const char mid[] = ",\"params\":";
+  static const char tail[] = ",\"id\":";
+  const size_t pflags = BITCOINRPC_METHOD_PFLAGS_;
+  json_t *jname = NULL;
+  char *post = NULL;
+  struct bitcoinrpc_method_slot_ *slots = NULL;
+  size_t name_len, params_len, len, nslots;
+
   if (NULL == method)
     return BITCOINRPCE_BUG;
 
-  if (NULL != method->post_json)
+  nslots = 0;
+  params_len = 2;
+  if (json_is_array(method->params_json))
     {
-      json_decref(method->post_json);
-      method->post_json = json_object();
-      if (NULL == method->post_json)
+      nslots = json_array_size(method->params_json);
+      if (nslots > method->slots_cap)
+        {
+          slots = bitcoinrpc_global_allocfunc(nslots * sizeof *slots);
+          if (NULL == slots)
+            return BITCOINRPCE_ALLOC;
+          bitcoinrpc_global_freefunc(method->slots);
+          method->slots = slots;
+          method->slots_cap = nslots;
+        }
+      method->nslots = 0;
+      for (size_t i = 0; i < nslots; i++)
+        {
+          len = json_dumpb(json_array_get(method->params_json, i), NULL, 0, pflags);
+          if (0 == len)
+            return BITCOINRPCE_JSON;
+          method->slots[i].len = len;
+          params_len += len + (i > 0);
+        }
+    }
+  else if (NULL != method->params_json)
+    {
+      params_len = json_dumpb(method->params_json, NULL, 0, pflags);
+      if (0 == params_len)
         return BITCOINRPCE_JSON;
     }
 
-  json_object_set_new(method->post_json, "method", json_string(method->mstr));
-  json_object_set_new(method->post_json, "id", json_string(method->uuid_str));
+  /* the name of a nonstandard method may need escaping */
+  if (BITCOINRPC_METHOD_NONSTANDARD == method->m)
+    {
+      jname = json_string(method->mstr);
+      if (NULL == jname)
+        return BITCOINRPCE_JSON;
+      name_len = json_dumpb(jname, NULL, 0, JSON_ENCODE_ANY);
+      if (0 == name_len)
+        {
+          json_decref(jname);
+          return BITCOINRPCE_JSON;
+        }
+    }
+  else
+    {
+      name_len = strlen(method->mstr) + 2;
+    }
 
-  if (NULL == method->params_json)
+  len = sizeof head - 1 + name_len + sizeof mid - 1 + params_len + sizeof tail - 1;
+  if (len + 1 > method->post_cap)
+    {
+      post = bitcoinrpc_global_allocfunc(len + 1 + BITCOINRPC_METHOD_POST_SLACK_);
+      if (NULL == post)
+        {
+          json_decref(jname);
+          return BITCOINRPCE_ALLOC;
+        }
+      bitcoinrpc_global_freefunc(method->post);
+      method->post = post;
+      method->post_cap = len + 1 + BITCOINRPC_METHOD_POST_SLACK_;
+    }
+  post = method->post;
+
+  len = 0;
+  memcpy(post + len, head, sizeof head - 1);
+  len += sizeof head - 1;
+  if (NULL != jname)
+    {
+      json_dumpb(jname, post + len, name_len, JSON_ENCODE_ANY);
+      json_decref(jname);
+    }
+  else
+    {
+      post[len] = '"';
+      memcpy(post + len + 1, method->mstr, name_len - 2);
+      post[len + name_len - 1] = '"';
+    }
+  len += name_len;
+  memcpy(post + len, mid, sizeof mid - 1);
+  len += sizeof mid - 1;
+  if (json_is_array(method->params_json))
     {
-      json_object_set_new(method->post_json, "params", json_array());
+      post[len++] = '[';
+      for (size_t i = 0; i < nslots; i++)
+        {
+          if (i > 0)
+            post[len++] = ',';
+          method->slots[i].off = len;
+          json_dumpb(json_array_get(method->params_json, i), post + len,
+                     method->slots[i].len, pflags);
+          len += method->slots[i].len;
+        }
+      post[len++] = ']';
+      method->nslots = nslots;
+    }
+  else if (NULL != method->params_json)
+    {
+      json_dumpb(method->params_json, post + len, params_len, pflags);
+      len += params_len;
     }
   else
     {
-      json_object_set(method->post_json, "params", method->params_json);
+      memcpy(post + len, "[]", 2);
+      len += 2;
     }
+  memcpy(post + len, tail, sizeof tail - 1);
+  len += sizeof tail - 1;
+  post[len] = '\0';
+  method->post_len = len;
 
   return BITCOINRPCE_OK;
 }
 
 
-json_t *
-bitcoinrpc_method_get_postjson_(bitcoinrpc_method_t *method)
+BITCOINRPCEcode
+bitcoinrpc_method_append_post_(bitcoinrpc_method_t *method,
+                               struct bitcoinrpc_buf_ *buf)
 {
-  if (NULL == method)
-    return NULL;
+  char id[24];
+  size_t k = sizeof id;
+  unsigned long long v;
+
+  if (bitcoinrpc_buf_reserve_(buf, method->post_len + BITCOINRPC_METHOD_ID_MAXLEN + 1)
+      != BITCOINRPCE_OK)
+    return BITCOINRPCE_ALLOC;
+
+  memcpy(buf->data + buf->len, method->post, method->post_len);
+  buf->len += method->post_len;
+
+  if (method->id != 0)
+    {
+      /* the counter only grows, so the id is positive */
+      v = (unsigned long long)method->id;
+      do
+        {
+          id[--k] = '0' + v % 10;
+          v /= 10;
+        }
+      while (v > 0);
+      memcpy(buf->data + buf->len, id + k, sizeof id - k);
+      buf->len += sizeof id - k;
+    }
+  else
+    {
+      buf->data[buf->len++] = '"';
+      memcpy(buf->data + buf->len, method->uuid_str, 36);
+      buf->len += 36;
+      buf->data[buf->len++] = '"';
+    }
+
+  buf->data[buf->len++] = '}';
+  buf->data[buf->len] = '\0';
 
-  return method->post_json;
+  return BITCOINRPCE_OK;
+}
+
+
+size_t
+bitcoinrpc_method_post_bytes_(bitcoinrpc_method_t *method)
+{
+  size_t digits = 1;
+
+  if (method->id == 0)
+    return method->post_len + BITCOINRPC_METHOD_ID_MAXLEN + 1;
+
+  for (unsigned long long v = (unsigned long long)method->id; v >= 10; v /= 10)
+    digits++;
+
+  return method->post_len + digits + 1;
 }
 
 
@@ -215,16 +388,144 @@ bitcoinrpc_method_compare_uuid_(bitcoinrpc_method_t *method, uuid_t u)
 }
 
 
-static BITCOINRPCEcode
-bitcoinrpc_method_update_uuid_(bitcoinrpc_method_t *method)
+BITCOINRPCEcode
+bitcoinrpc_method_compare_id_(bitcoinrpc_method_t *method, json_int_t id)
+{
+  if (NULL == method)
+    return BITCOINRPCE_BUG;
+
+  return (method->id != 0 && method->id == id) ?
+         BITCOINRPCE_OK : BITCOINRPCE_CHECK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_uuid_(bitcoinrpc_method_t *method)
 {
   if (NULL == method)
     return BITCOINRPCE_BUG;
 
+  /* keep the UUID the method already has */
+  if (method->uuid_str[0] != '\0')
+    return BITCOINRPCE_OK;
+
   uuid_generate_random(method->uuid);
   uuid_unparse_lower(method->uuid, method->uuid_str);
+  method->id = 0;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_id_(bitcoinrpc_method_t *method, json_int_t id)
+{
+  if (NULL == method)
+    return BITCOINRPCE_BUG;
+
+  /* a new UUID will be needed, if the method is called with one again */
+  method->uuid_str[0] = '\0';
+  uuid_clear(method->uuid);
+  method->id = id;
+
+  return BITCOINRPCE_OK;
+}
+
+
+/*
+   The method has changed: forget its id and serialise it again.  A new id
+   is set when the method is called (see bitcoinrpc_call_prepare_()).
+ */
+static BITCOINRPCEcode
+bitcoinrpc_method_reset_id_(bitcoinrpc_method_t *method)
+{
+  if (NULL == method)
+    return BITCOINRPCE_BUG;
+
+  method->uuid_str[0] = '\0';
+  uuid_clear(method->uuid);
+  method->id = 0;
+
+  return bitcoinrpc_method_make_post_(method);
+}
+
+
+/*
+   The i-th parameter has changed: dump it again over its old place in the
+   post, moving the rest, or serialise the whole post, if it does not fit.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_method_update_slot_(bitcoinrpc_method_t *method, size_t i)
+{
+  struct bitcoinrpc_method_slot_ *slot = NULL;
+  json_t *value = json_array_get(method->params_json, i);
+  size_t len, end;
+
+  if (NULL == value || i >= method->nslots)
+    return bitcoinrpc_method_reset_id_(method);
+
+  slot = &method->slots[i];
+  len = json_dumpb(value, NULL, 0, BITCOINRPC_METHOD_PFLAGS_);
+  if (0 == len)
+    return BITCOINRPCE_JSON;
+  if (method->post_len - slot->len + len + 1 > method->post_cap)
+    return bitcoinrpc_method_reset_id_(method);
+
+  end = slot->off + slot->len;
+  memmove(method->post + slot->off + len, method->post + end,
+          method->post_len - end + 1);
+  json_dumpb(value, method->post + slot->off, len, BITCOINRPC_METHOD_PFLAGS_);
+  method->post_len = method->post_len - slot->len + len;
+  for (size_t j = i + 1; j < method->nslots; j++)
+    method->slots[j].off = method->slots[j].off - slot->len + len;
+  slot->len = len;
+
+  method->uuid_str[0] = '\0';
+  uuid_clear(method->uuid);
+  method->id = 0;
 
-  return bitcoinrpc_method_make_postjson_(method);
+  return BITCOINRPCE_OK;
+}
+
+
+/*
+   Put a new value (taking its reference) as the i-th parameter: in place of
+   an old one, or at the end of the array.
+ */
+static BITCOINRPCEcode
+bitcoinrpc_method_put_param_(bitcoinrpc_method_t *method, size_t i, json_t *value)
+{
+  if (NULL == value)
+    return BITCOINRPCE_JSON;
+
+  if (NULL == method->params_json)
+    {
+      method->params_json = json_array();
+      if (NULL == method->params_json)
+        {
+          json_decref(value);
+          return BITCOINRPCE_JSON;
+        }
+    }
+
+  if (!json_is_array(method->params_json)
+      || i > json_array_size(method->params_json))
+    {
+      json_decref(value);
+      return BITCOINRPCE_ARG;
+    }
+
+  if (i == json_array_size(method->params_json))
+    {
+      if (json_array_append_new(method->params_json, value) != 0)
+        return BITCOINRPCE_JSON;
+    }
+  else if (json_array_set_new(method->params_json, i, value) != 0)
+    {
+      return BITCOINRPCE_JSON;
+    }
+
+  return bitcoinrpc_method_update_slot_(method, i);
 }
 
 
@@ -268,10 +569,15 @@ bitcoinrpc_method_init_params(const BITCOINRPC_METHOD m,
   method->mstr = ms->str;
   method->params_json = jp;
 
-  /* make post_json */
-  method->post_json = NULL;
-  method->post_json = json_object();
-  if (NULL == method->post_json || bitcoinrpc_method_update_uuid_(method) != BITCOINRPCE_OK)
+  /* make post */
+  method->post = NULL;
+  method->post_len = 0;
+  method->post_cap = 0;
+  method->slots = NULL;
+  method->nslots = 0;
+  method->slots_cap = 0;
+  method->pool_next = NULL;
+  if (bitcoinrpc_method_reset_id_(method) != BITCOINRPCE_OK)
     {
       if (jp != NULL)
         json_decref(jp);
@@ -289,7 +595,8 @@ bitcoinrpc_method_free(bitcoinrpc_method_t *method)
   if (NULL == method)
     return BITCOINRPCE_ARG;
 
-  json_decref(method->post_json);
+  bitcoinrpc_global_freefunc(method->post);
+  bitcoinrpc_global_freefunc(method->slots);
   if (method->params_json != NULL)
     json_decref(method->params_json);
 
@@ -325,7 +632,109 @@ bitcoinrpc_method_set_params(bitcoinrpc_method_t *method, json_t *params)
 
   method->params_json = jp;
 
-  return bitcoinrpc_method_update_uuid_(method);
+  return bitcoinrpc_method_reset_id_(method);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_reset(bitcoinrpc_method_t *method, const BITCOINRPC_METHOD m,
+                        json_t * const params)
+{
+  const struct BITCOINRPC_METHOD_struct_ *ms = bitcoinrpc_method_st_(m);
+  json_t *jp = NULL;
+
+  if (NULL == method || NULL == ms)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != params)
+    {
+      jp = json_deep_copy(params);
+      if (NULL == jp)
+        return BITCOINRPCE_JSON;
+    }
+
+  if (method->params_json != NULL)
+    json_decref(method->params_json);
+
+  method->m = m;
+  method->mstr = ms->str;
+  method->params_json = jp;
+
+  /* the post is serialised again into the same memory, if it fits */
+  return bitcoinrpc_method_reset_id_(method);
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_int(bitcoinrpc_method_t *method, size_t i,
+                                json_int_t value)
+{
+  json_t *v = NULL;
+
+  if (NULL == method)
+    return BITCOINRPCE_ARG;
+
+  v = json_array_get(method->params_json, i);
+  if (json_is_integer(v))
+    {
+      json_integer_set(v, value);
+      return bitcoinrpc_method_update_slot_(method, i);
+    }
+
+  return bitcoinrpc_method_put_param_(method, i, json_integer(value));
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_real(bitcoinrpc_method_t *method, size_t i,
+                                 double value)
+{
+  json_t *v = NULL;
+
+  if (NULL == method)
+    return BITCOINRPCE_ARG;
+
+  v = json_array_get(method->params_json, i);
+  if (json_is_real(v))
+    {
+      if (json_real_set(v, value) != 0)
+        return BITCOINRPCE_JSON;
+      return bitcoinrpc_method_update_slot_(method, i);
+    }
+
+  return bitcoinrpc_method_put_param_(method, i, json_real(value));
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_str(bitcoinrpc_method_t *method, size_t i,
+                                const char *value)
+{
+  json_t *v = NULL;
+
+  if (NULL == method || NULL == value)
+    return BITCOINRPCE_ARG;
+
+  v = json_array_get(method->params_json, i);
+  if (json_is_string(v))
+    {
+      if (json_string_set(v, value) != 0)
+        return BITCOINRPCE_JSON;
+      return bitcoinrpc_method_update_slot_(method, i);
+    }
+
+  return bitcoinrpc_method_put_param_(method, i, json_string(value));
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_method_set_param_bool(bitcoinrpc_method_t *method, size_t i,
+                                 int value)
+{
+  if (NULL == method)
+    return BITCOINRPCE_ARG;
+
+  return bitcoinrpc_method_put_param_(method, i, json_boolean(value));
 }
 
 
@@ -365,7 +774,7 @@ bitcoinrpc_method_set_nonstandard(bitcoinrpc_method_t *method, char *name)
 
   method->mstr = name;
 
-  return bitcoinrpc_method_update_uuid_(method);
+  return bitcoinrpc_method_reset_id_(method);
 }
 
 
@@ -377,3 +786,80 @@ bitcoinrpc_method_get_mstr_(bitcoinrpc_method_t *method)
 
   return method->mstr;
 }
+
+
+#define BITCOINRPC_METHOD_KEYFLAGS_ (JSON_COMPACT | JSON_SORT_KEYS | JSON_ENCODE_ANY)
+
+/* Write the key to buf, if it fits in cap bytes; return its length, 0 on error */
+static size_t
+bitcoinrpc_method_write_key_(bitcoinrpc_method_t *method, char *buf, size_t cap)
+{
+  size_t name_len = strlen(method->mstr);
+  size_t params_len = 2;
+
+  if (NULL != method->params_json)
+    {
+      params_len = json_dumpb(method->params_json, NULL, 0, BITCOINRPC_METHOD_KEYFLAGS_);
+      if (0 == params_len)
+        return 0;
+    }
+  if (name_len + 1 + params_len > cap)
+    return name_len + 1 + params_len;
+
+  memcpy(buf, method->mstr, name_len);
+  buf[name_len] = ' ';
+  if (NULL != method->params_json)
+    json_dumpb(method->params_json, buf + name_len + 1, params_len,
+               BITCOINRPC_METHOD_KEYFLAGS_);
+  else
+    memcpy(buf + name_len + 1, "[]", 2);
+
+  return name_len + 1 + params_len;
+}
+
+
+char *
+bitcoinrpc_method_key_(bitcoinrpc_method_t *method, char *buf, size_t *len)
+{
+  char *key = buf;
+
+  if (NULL == method || NULL == method->mstr)
+    return NULL;
+
+  *len = bitcoinrpc_method_write_key_(method, buf, BITCOINRPC_METHOD_KEYLEN);
+  if (0 == *len)
+    return NULL;
+  if (*len > BITCOINRPC_METHOD_KEYLEN)
+    {
+      key = bitcoinrpc_global_allocfunc(*len);
+      if (NULL == key)
+        return NULL;
+      bitcoinrpc_method_write_key_(method, key, *len);
+    }
+
+  return key;
+}
+
+
+void
+bitcoinrpc_method_key_free_(char *key, char *buf)
+{
+  if (key != buf)
+    bitcoinrpc_global_freefunc(key);
+}
+
+
+/* FNV-1a */
+size_t
+bitcoinrpc_method_key_hash_(const char *key, size_t len)
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < len; i++)
+    {
+      h ^= (unsigned char)key[i];
+      h *= 1099511628211ULL;
+    }
+
+  return (size_t)h;
+}
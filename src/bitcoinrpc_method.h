@@ -31,6 +31,14 @@
 
 #include <uuid/uuid.h>
 #include "bitcoinrpc.h"
+#include "bitcoinrpc_buf.h"
+
+
+/* Where a parameter (an element of the params array) is in the post */
+struct bitcoinrpc_method_slot_ {
+  size_t off;
+  size_t len;
+};
 
 
 struct bitcoinrpc_method {
@@ -39,9 +47,22 @@ struct bitcoinrpc_method {
 
   uuid_t uuid;
   char uuid_str[37];      /* why 37? see: man 3 uuid_unparse */
+                          /* empty (and uuid null), if the uuid is not set */
+  json_int_t id;          /* integer id, if not 0 (BITCOINRPC_ID_COUNTER) */
 
   json_t  *params_json;
-  json_t  *post_json;
+
+  /* the request up to the id; see: bitcoinrpc_method_append_post_() */
+  char *post;
+  size_t post_len;
+  size_t post_cap;        /* allocated size, kept by bitcoinrpc_method_reset() */
+
+  /* if params is an array; see: bitcoinrpc_method_set_param_int() */
+  struct bitcoinrpc_method_slot_ *slots;
+  size_t nslots;
+  size_t slots_cap;
+
+  struct bitcoinrpc_method *pool_next;    /* in bitcoinrpc_objpool_t */
 
   /*
      This is a legacy pointer. You can point to an auxilliary structure,
@@ -54,10 +75,52 @@ struct bitcoinrpc_method {
 BITCOINRPCEcode
 bitcoinrpc_method_compare_uuid_(bitcoinrpc_method_t *method, uuid_t u);
 
-json_t *
-bitcoinrpc_method_get_postjson_(bitcoinrpc_method_t *method);
+BITCOINRPCEcode
+bitcoinrpc_method_compare_id_(bitcoinrpc_method_t *method, json_int_t id);
+
+/* Identify the method with a random UUID, unless it has got one already */
+BITCOINRPCEcode
+bitcoinrpc_method_set_uuid_(bitcoinrpc_method_t *method);
+
+/* Identify the method with an integer id (must not be 0) */
+BITCOINRPCEcode
+bitcoinrpc_method_set_id_(bitcoinrpc_method_t *method, json_int_t id);
+
+/* The longest id appended by bitcoinrpc_method_append_post_(), quotes included */
+#define BITCOINRPC_METHOD_ID_MAXLEN 38
+
+/* Append the request (a JSON object) to buf */
+BITCOINRPCEcode
+bitcoinrpc_method_append_post_(bitcoinrpc_method_t *method,
+                               struct bitcoinrpc_buf_ *buf);
+
+/* The length of the request appended by bitcoinrpc_method_append_post_() */
+size_t
+bitcoinrpc_method_post_bytes_(bitcoinrpc_method_t *method);
+
+/* The name of a standard method, or NULL */
+const char *
+bitcoinrpc_method_name_(const BITCOINRPC_METHOD m);
 
 char *
 bitcoinrpc_method_get_mstr_(bitcoinrpc_method_t *method);
 
+/*
+   Identify what the method asks for, regardless of its id: its name and
+   params (dumped with sorted keys).  The key is written to buf, of
+   BITCOINRPC_METHOD_KEYLEN bytes, or allocated, if longer (free it with
+   bitcoinrpc_method_key_free_()).  Its length is stored in len.
+   Return NULL in case of error.
+ */
+#define BITCOINRPC_METHOD_KEYLEN 256
+
+char *
+bitcoinrpc_method_key_(bitcoinrpc_method_t *method, char *buf, size_t *len);
+
+void
+bitcoinrpc_method_key_free_(char *key, char *buf);
+
+size_t
+bitcoinrpc_method_key_hash_(const char *key, size_t len);
+
 #endif /* BITCOINRPC_METHOD_H_1d9cedfd_a1d6_4b80_9ad4_fcc4549abcad */
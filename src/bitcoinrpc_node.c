@@ -0,0 +1,309 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Balancing the blocking calls of a client among many nodes.  Every node
+   is a client of its own (with its own connections); the calls are still
+   made by the client they are made with, so that the ids, the statistics
+   and the cache stay shared.  A node which fails eject_failures times in a
+   row (with a transport error) is ejected for eject_seconds, then tried
+   again.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_call.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_node.h"
+
+
+#define BITCOINRPC_NODE_EJECT_FAILURES_ 3
+#define BITCOINRPC_NODE_EJECT_SECONDS_ 10.0
+
+/* The weight of a new latency in the average */
+#define BITCOINRPC_NODE_EWMA_ALPHA_ 0.2
+
+
+/* The table of the client, made on first use, with the client as the first node */
+static struct bitcoinrpc_node_table_ *
+bitcoinrpc_node_table_(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_node_table_ *t = cl->nodes;
+
+  if (NULL != t)
+    return t;
+
+  t = bitcoinrpc_global_allocfunc(sizeof *t);
+  if (NULL == t)
+    return NULL;
+  memset(t, 0, sizeof *t);
+  if (pthread_mutex_init(&t->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(t);
+      return NULL;
+    }
+  t->balance = BITCOINRPC_BALANCE_LEAST_OUTSTANDING;
+  t->eject_failures = BITCOINRPC_NODE_EJECT_FAILURES_;
+  t->eject_seconds = BITCOINRPC_NODE_EJECT_SECONDS_;
+  t->node[0].cl = cl;
+  t->n = 1;
+
+  cl->nodes = t;
+
+  return t;
+}
+
+
+void
+bitcoinrpc_node_free_table_(struct bitcoinrpc_node_table_ *table)
+{
+  if (NULL == table)
+    return;
+
+  for (size_t i = 1; i < table->n; i++)
+    bitcoinrpc_cl_free(table->node[i].cl);
+  pthread_mutex_destroy(&table->lock);
+  bitcoinrpc_global_freefunc(table);
+}
+
+
+/* Whether a is a better choice than b (which may be NULL) */
+static int
+bitcoinrpc_node_better_(BITCOINRPC_BALANCE balance, struct bitcoinrpc_node_ *a,
+                        struct bitcoinrpc_node_ *b)
+{
+  if (NULL == b)
+    return 1;
+
+  if (BITCOINRPC_BALANCE_EWMA == balance)
+    return (a->outstanding + 1) * a->ewma < (b->outstanding + 1) * b->ewma;
+
+  return a->outstanding < b->outstanding;
+}
+
+
+struct bitcoinrpc_node_ *
+bitcoinrpc_node_pick_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *exclude)
+{
+  struct bitcoinrpc_node_table_ *t = cl->nodes;
+  struct bitcoinrpc_node_ *best = NULL;
+  struct bitcoinrpc_node_ *node = NULL;
+  double now;
+
+  if (NULL == t)
+    return NULL;
+
+  now = bitcoinrpc_call_now_();
+  pthread_mutex_lock(&t->lock);
+  for (size_t k = 0; k < t->n; k++)
+    {
+      node = &t->node[(t->next + k) % t->n];
+      if (node->ejected_until > now || node == exclude)
+        continue;
+      if (bitcoinrpc_node_better_(t->balance, node, best))
+        best = node;
+    }
+
+  /* all of them are ejected: try the one to come back first */
+  if (NULL == best && NULL == exclude)
+    for (size_t i = 0; i < t->n; i++)
+      if (NULL == best || t->node[i].ejected_until < best->ejected_until)
+        best = &t->node[i];
+
+  t->next = (t->next + 1) % t->n;
+  if (NULL != best)
+    best->outstanding++;
+  pthread_mutex_unlock(&t->lock);
+
+  return best;
+}
+
+
+void
+bitcoinrpc_node_done_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *node,
+                      BITCOINRPCEcode code, double seconds)
+{
+  struct bitcoinrpc_node_table_ *t = cl->nodes;
+
+  if (NULL == node)
+    return;
+
+  pthread_mutex_lock(&t->lock);
+  node->outstanding--;
+  node->calls++;
+  if (BITCOINRPCE_CURLE == code || BITCOINRPCE_CON == code || BITCOINRPCE_BUSY == code)
+    {
+      node->errors++;
+      if (++node->failures >= t->eject_failures)
+        node->ejected_until = bitcoinrpc_call_now_() + t->eject_seconds;
+    }
+  else
+    {
+      node->failures = 0;
+      node->ejected_until = 0;
+      if (0 == node->ewma)
+        node->ewma = seconds;
+      else
+        node->ewma += BITCOINRPC_NODE_EWMA_ALPHA_ * (seconds - node->ewma);
+    }
+  pthread_mutex_unlock(&t->lock);
+}
+
+
+void
+bitcoinrpc_node_cancel_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *node,
+                        double seconds)
+{
+  struct bitcoinrpc_node_table_ *t = cl->nodes;
+
+  if (NULL == node)
+    return;
+
+  pthread_mutex_lock(&t->lock);
+  node->outstanding--;
+  /* it would have taken at least as long */
+  if (0 == node->ewma)
+    node->ewma = seconds;
+  else if (seconds > node->ewma)
+    node->ewma += BITCOINRPC_NODE_EWMA_ALPHA_ * (seconds - node->ewma);
+  pthread_mutex_unlock(&t->lock);
+}
+
+
+/* ------------------------------------------------------------------------  */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_add_node(bitcoinrpc_cl_t *cl, const char* user, const char* pass,
+                       const char* addr, const unsigned int port)
+{
+  struct bitcoinrpc_node_table_ *t = NULL;
+  bitcoinrpc_cl_t *node = NULL;
+  BITCOINRPCEcode ecode;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  t = bitcoinrpc_node_table_(cl);
+  if (NULL == t)
+    return BITCOINRPCE_ALLOC;
+  if (t->n == BITCOINRPC_NODES_MAX)
+    return BITCOINRPCE_ERR;
+
+  /* the same kind of client as the one it is added to */
+  node = bitcoinrpc_cl_init_(user, pass, addr, port, cl->pool_max, NULL != cl->curlsh,
+                             &ecode);
+  if (NULL == node)
+    return ecode;
+
+  pthread_mutex_lock(&t->lock);
+  memset(&t->node[t->n], 0, sizeof t->node[t->n]);
+  t->node[t->n].cl = node;
+  t->n++;
+  pthread_mutex_unlock(&t->lock);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_balance(bitcoinrpc_cl_t *cl, BITCOINRPC_BALANCE balance)
+{
+  struct bitcoinrpc_node_table_ *t = NULL;
+
+  if (NULL == cl || (balance != BITCOINRPC_BALANCE_LEAST_OUTSTANDING
+                     && balance != BITCOINRPC_BALANCE_EWMA))
+    return BITCOINRPCE_ARG;
+
+  t = bitcoinrpc_node_table_(cl);
+  if (NULL == t)
+    return BITCOINRPCE_ALLOC;
+
+  pthread_mutex_lock(&t->lock);
+  t->balance = balance;
+  pthread_mutex_unlock(&t->lock);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_set_ejection(bitcoinrpc_cl_t *cl, unsigned int failures, double seconds)
+{
+  struct bitcoinrpc_node_table_ *t = NULL;
+
+  if (NULL == cl || 0 == failures || seconds < 0)
+    return BITCOINRPCE_ARG;
+
+  t = bitcoinrpc_node_table_(cl);
+  if (NULL == t)
+    return BITCOINRPCE_ALLOC;
+
+  pthread_mutex_lock(&t->lock);
+  t->eject_failures = failures;
+  t->eject_seconds = seconds;
+  pthread_mutex_unlock(&t->lock);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_get_nodestats(bitcoinrpc_cl_t *cl, bitcoinrpc_nodestats_t *nodestats,
+                            size_t *n)
+{
+  struct bitcoinrpc_node_table_ *t = NULL;
+  double now = bitcoinrpc_call_now_();
+  size_t i;
+
+  if (NULL == cl || NULL == n || (NULL == nodestats && *n > 0))
+    return BITCOINRPCE_ARG;
+
+  t = cl->nodes;
+  if (NULL == t)
+    return BITCOINRPCE_ERR;
+
+  pthread_mutex_lock(&t->lock);
+  for (i = 0; i < t->n && i < *n; i++)
+    {
+      struct bitcoinrpc_node_ *node = &t->node[i];
+      bitcoinrpc_nodestats_t *ns = &nodestats[i];
+
+      memcpy(ns->addr, node->cl->addr, BITCOINRPC_PARAM_MAXLEN);
+      ns->port = node->cl->port;
+      ns->outstanding = node->outstanding;
+      ns->ewma = node->ewma;
+      ns->calls = node->calls;
+      ns->errors = node->errors;
+      ns->ejected = node->ejected_until > now;
+    }
+  *n = t->n;
+  pthread_mutex_unlock(&t->lock);
+
+  return BITCOINRPCE_OK;
+}
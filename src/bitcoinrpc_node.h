@@ -0,0 +1,83 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Balancing the blocking calls of a client among many nodes
+ */
+
+#ifndef BITCOINRPC_NODE_H_c2a94e61_5b3f_4d70_8e1a_7f6d09b3c5e2
+#define BITCOINRPC_NODE_H_c2a94e61_5b3f_4d70_8e1a_7f6d09b3c5e2
+
+#include <pthread.h>
+#include "bitcoinrpc.h"
+
+struct bitcoinrpc_node_ {
+  bitcoinrpc_cl_t *cl;      /* whose connections are used (the client itself first) */
+  size_t outstanding;       /* calls in progress */
+  double ewma;              /* of the latency of successful calls; 0 until the first */
+  unsigned int failures;    /* in a row */
+  double ejected_until;     /* see: bitcoinrpc_call_now_(); 0, if healthy */
+  unsigned long long calls;
+  unsigned long long errors;
+};
+
+struct bitcoinrpc_node_table_ {
+  pthread_mutex_t lock;
+  BITCOINRPC_BALANCE balance;
+  unsigned int eject_failures;
+  double eject_seconds;
+  size_t next;              /* where to start looking, so that ties take turns */
+  size_t n;
+  struct bitcoinrpc_node_ node[BITCOINRPC_NODES_MAX];
+};
+
+
+/* Free the nodes added to the client (not the client itself) */
+void
+bitcoinrpc_node_free_table_(struct bitcoinrpc_node_table_ *table);
+
+/*
+   Pick the node for the next call and count it as outstanding.
+   Return NULL, if the client has no nodes added (use its own connections).
+   If exclude is not NULL, pick a healthy node other than exclude, or none.
+ */
+struct bitcoinrpc_node_ *
+bitcoinrpc_node_pick_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *exclude);
+
+/* The call made with node has ended with code after seconds */
+void
+bitcoinrpc_node_done_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *node,
+                      BITCOINRPCEcode code, double seconds);
+
+/*
+   The call made with node has been cancelled after seconds, because another
+   node has answered first.  This is not a failure, but the node is slow.
+ */
+void
+bitcoinrpc_node_cancel_(bitcoinrpc_cl_t *cl, struct bitcoinrpc_node_ *node,
+                        double seconds);
+
+#endif /* BITCOINRPC_NODE_H_c2a94e61_5b3f_4d70_8e1a_7f6d09b3c5e2 */
@@ -0,0 +1,209 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Pools of methods and responses, to be reused instead of freed
+ */
+
+#include <pthread.h>
+
+#include <jansson.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_method.h"
+#include "bitcoinrpc_resp.h"
+
+
+struct bitcoinrpc_objpool {
+
+  pthread_mutex_t lock;
+  size_t max;                       /* of each kind, 0 means no limit */
+
+  bitcoinrpc_method_t *methods;     /* linked by pool_next */
+  size_t nmethods;
+  bitcoinrpc_resp_t *resps;
+  size_t nresps;
+};
+
+
+bitcoinrpc_objpool_t *
+bitcoinrpc_objpool_init(size_t max)
+{
+  bitcoinrpc_objpool_t *pool = bitcoinrpc_global_allocfunc(sizeof *pool);
+
+  if (NULL == pool)
+    return NULL;
+
+  if (pthread_mutex_init(&pool->lock, NULL) != 0)
+    {
+      bitcoinrpc_global_freefunc(pool);
+      return NULL;
+    }
+  pool->max = max;
+  pool->methods = NULL;
+  pool->nmethods = 0;
+  pool->resps = NULL;
+  pool->nresps = 0;
+
+  return pool;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_objpool_free(bitcoinrpc_objpool_t *pool)
+{
+  if (NULL == pool)
+    return BITCOINRPCE_ARG;
+
+  while (pool->methods != NULL)
+    {
+      bitcoinrpc_method_t *method = pool->methods;
+      pool->methods = method->pool_next;
+      bitcoinrpc_method_free(method);
+    }
+  while (pool->resps != NULL)
+    {
+      bitcoinrpc_resp_t *resp = pool->resps;
+      pool->resps = resp->pool_next;
+      bitcoinrpc_resp_free(resp);
+    }
+  pthread_mutex_destroy(&pool->lock);
+  bitcoinrpc_global_freefunc(pool);
+
+  return BITCOINRPCE_OK;
+}
+
+
+bitcoinrpc_method_t *
+bitcoinrpc_objpool_get_method(bitcoinrpc_objpool_t *pool, const BITCOINRPC_METHOD m,
+                              json_t * const params)
+{
+  bitcoinrpc_method_t *method = NULL;
+
+  if (NULL == pool)
+    return NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  method = pool->methods;
+  if (method != NULL)
+    {
+      pool->methods = method->pool_next;
+      pool->nmethods--;
+    }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (NULL == method)
+    return bitcoinrpc_method_init_params(m, params);
+
+  method->pool_next = NULL;
+  if (bitcoinrpc_method_reset(method, m, params) != BITCOINRPCE_OK)
+    {
+      bitcoinrpc_method_free(method);
+      return NULL;
+    }
+
+  return method;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_objpool_put_method(bitcoinrpc_objpool_t *pool, bitcoinrpc_method_t *method)
+{
+  if (NULL == pool || NULL == method)
+    return BITCOINRPCE_ARG;
+
+  /* drop the params now: they belong to the user's data, not to the pool */
+  if (method->params_json != NULL)
+    json_decref(method->params_json);
+  method->params_json = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->max == 0 || pool->nmethods < pool->max)
+    {
+      method->pool_next = pool->methods;
+      pool->methods = method;
+      pool->nmethods++;
+      method = NULL;
+    }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (method != NULL)
+    bitcoinrpc_method_free(method);
+
+  return BITCOINRPCE_OK;
+}
+
+
+bitcoinrpc_resp_t *
+bitcoinrpc_objpool_get_resp(bitcoinrpc_objpool_t *pool)
+{
+  bitcoinrpc_resp_t *resp = NULL;
+
+  if (NULL == pool)
+    return NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  resp = pool->resps;
+  if (resp != NULL)
+    {
+      pool->resps = resp->pool_next;
+      pool->nresps--;
+    }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (NULL == resp)
+    return bitcoinrpc_resp_init();
+
+  resp->pool_next = NULL;
+
+  return resp;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_objpool_put_resp(bitcoinrpc_objpool_t *pool, bitcoinrpc_resp_t *resp)
+{
+  if (NULL == pool || NULL == resp)
+    return BITCOINRPCE_ARG;
+
+  bitcoinrpc_resp_reset(resp);
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->max == 0 || pool->nresps < pool->max)
+    {
+      resp->pool_next = pool->resps;
+      pool->resps = resp;
+      pool->nresps++;
+      resp = NULL;
+    }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (resp != NULL)
+    bitcoinrpc_resp_free(resp);
+
+  return BITCOINRPCE_OK;
+}
@@ -22,6 +22,7 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
 #include <jansson.h>
 #include <uuid/uuid.h>
 
@@ -32,7 +33,12 @@
 
 
 
-/* Internal stuff */
+/*
+   Internal stuff
+
+   The response keeps a reference to json (no copy is made): an element of
+   the batch just parsed is owned by nobody else.
+ */
 BITCOINRPCEcode
 bitcoinrpc_resp_set_json_(bitcoinrpc_resp_t *resp, json_t *json)
 {
@@ -42,15 +48,7 @@ bitcoinrpc_resp_set_json_(bitcoinrpc_resp_t *resp, json_t *json)
   if (NULL != resp->json)
     json_decref(resp->json);
 
-  if (NULL == json)
-    {
-      resp->json = NULL;
-      return BITCOINRPCE_OK;
-    }
-
-  resp->json = json_deep_copy(json);
-  if (NULL == resp->json)
-    return BITCOINRPCE_JSON;
+  resp->json = json_incref(json);
 
   return BITCOINRPCE_OK;
 }
@@ -69,10 +67,7 @@ bitcoinrpc_resp_update_uuid_(bitcoinrpc_resp_t *resp)
   if (NULL == resp->json)
     return BITCOINRPCE_OK;
 
-  json_t *jid = json_deep_copy(json_object_get(resp->json, "id"));
-  if (NULL == jid)
-    return BITCOINRPCE_JSON;
-  uuid_str = json_string_value(jid);
+  uuid_str = json_string_value(json_object_get(resp->json, "id"));
   if (NULL == uuid_str)
     return BITCOINRPCE_JSON;
 
@@ -80,7 +75,6 @@ bitcoinrpc_resp_update_uuid_(bitcoinrpc_resp_t *resp)
   if (e != 0)
     return BITCOINRPCE_BUG;
   uuid_copy(resp->uuid, uuid);
-  json_decref(jid);
 
   return BITCOINRPCE_OK;
 }
@@ -95,10 +89,30 @@ bitcoinrpc_resp_init(void)
     return NULL;
 
   resp->json = NULL;
+  bitcoinrpc_resp_reset(resp);
+  resp->pool_next = NULL;
   return resp;
 }
 
 
+BITCOINRPCEcode
+bitcoinrpc_resp_reset(bitcoinrpc_resp_t *resp)
+{
+  if (NULL == resp)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != resp->json)
+    json_decref(resp->json);
+  resp->json = NULL;
+  uuid_clear(resp->uuid);
+  memset(&resp->timings, 0, sizeof resp->timings);
+  resp->bytes = 0;
+  memset(&resp->memstats, 0, sizeof resp->memstats);
+
+  return BITCOINRPCE_OK;
+}
+
+
 BITCOINRPCEcode
 bitcoinrpc_resp_free(bitcoinrpc_resp_t *resp)
 {
@@ -129,6 +143,44 @@ bitcoinrpc_resp_get(bitcoinrpc_resp_t *resp)
   return json_deep_copy(resp->json);
 }
 
+
+/*
+   Get the json object representing the response without copying it.
+   It is owned by resp: valid until resp is freed or used for another call.
+ */
+json_t *
+bitcoinrpc_resp_get_borrowed(bitcoinrpc_resp_t *resp)
+{
+  if (NULL == resp)
+    return NULL;
+
+  return resp->json;
+}
+
+BITCOINRPCEcode
+bitcoinrpc_resp_get_timings(bitcoinrpc_resp_t *resp, bitcoinrpc_timings_t *timings)
+{
+  if (NULL == resp || NULL == timings)
+    return BITCOINRPCE_ARG;
+
+  *timings = resp->timings;
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_resp_get_memstats(bitcoinrpc_resp_t *resp, bitcoinrpc_memstats_t *memstats)
+{
+  if (NULL == resp || NULL == memstats)
+    return BITCOINRPCE_ARG;
+
+  *memstats = resp->memstats;
+
+  return BITCOINRPCE_OK;
+}
+
+
 /*
    Check if the resp comes as a result of calling method.
    Returns BITCOINRPCE_CHECK, if not. This check is already performed by
@@ -140,6 +192,11 @@ bitcoinrpc_resp_check(bitcoinrpc_resp_t *resp, bitcoinrpc_method_t *method)
   if (NULL == resp || NULL == method)
     return BITCOINRPCE_ARG;
 
+  /* see: BITCOINRPC_ID_COUNTER */
+  json_t *jid = (NULL != resp->json) ? json_object_get(resp->json, "id") : NULL;
+  if (json_is_integer(jid))
+    return bitcoinrpc_method_compare_id_(method, json_integer_value(jid));
+
   bitcoinrpc_resp_update_uuid_(resp);
   return bitcoinrpc_method_compare_uuid_(method, resp->uuid);
 }
@@ -36,6 +36,11 @@
 struct bitcoinrpc_resp {
   uuid_t uuid;
   json_t  *json;
+  bitcoinrpc_timings_t timings;
+  size_t bytes;           /* of the response, if the client keeps statistics */
+  bitcoinrpc_memstats_t memstats;   /* of the call */
+
+  struct bitcoinrpc_resp *pool_next;      /* in bitcoinrpc_objpool_t */
 
   /*
      This is a legacy pointer. You can point to an auxilliary structure,
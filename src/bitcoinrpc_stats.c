@@ -0,0 +1,366 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+   Per-method statistics: counters and latency histograms
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <jansson.h>
+
+#include "bitcoinrpc.h"
+#include "bitcoinrpc_cl.h"
+#include "bitcoinrpc_global.h"
+#include "bitcoinrpc_method.h"
+#include "bitcoinrpc_resp.h"
+#include "bitcoinrpc_stats.h"
+
+
+/*
+   Internal stuff
+
+   The histogram is log-linear (as HDR histograms are): latencies in
+   microseconds below BITCOINRPC_STATS_SUB_ get a bucket each, then every
+   power of two is split into BITCOINRPC_STATS_SUB_ buckets of equal width,
+   so the error is at most 1/BITCOINRPC_STATS_SUB_.
+ */
+#define BITCOINRPC_STATS_SUB_ 8
+#define BITCOINRPC_STATS_SUBBITS_ 3
+
+static size_t
+bitcoinrpc_stats_bucket_(unsigned long long us)
+{
+  int e;
+  size_t i;
+
+  if (us < BITCOINRPC_STATS_SUB_)
+    return (size_t)us;
+
+  e = 63 - __builtin_clzll(us);
+  i = (size_t)(e - BITCOINRPC_STATS_SUBBITS_ + 1) * BITCOINRPC_STATS_SUB_
+      + ((us >> (e - BITCOINRPC_STATS_SUBBITS_)) & (BITCOINRPC_STATS_SUB_ - 1));
+
+  return (i < BITCOINRPC_STATS_BUCKETS) ? i : BITCOINRPC_STATS_BUCKETS - 1;
+}
+
+
+/* The upper bound of the bucket i, in microseconds */
+static unsigned long long
+bitcoinrpc_stats_bucket_max_(size_t i)
+{
+  int e;
+
+  if (i < BITCOINRPC_STATS_SUB_)
+    return i + 1;
+
+  e = (int)(i / BITCOINRPC_STATS_SUB_) + BITCOINRPC_STATS_SUBBITS_ - 1;
+  return (unsigned long long)(BITCOINRPC_STATS_SUB_ + i % BITCOINRPC_STATS_SUB_ + 1)
+         << (e - BITCOINRPC_STATS_SUBBITS_);
+}
+
+
+/* FNV-1a */
+static size_t
+bitcoinrpc_stats_hash_(const char *s)
+{
+  uint64_t h = 14695981039346656037ULL;
+
+  while ('\0' != *s)
+    {
+      h ^= (unsigned char)*s++;
+      h *= 1099511628211ULL;
+    }
+
+  return (size_t)h;
+}
+
+
+/* Find (or take) the slot of a nonstandard method name */
+static bitcoinrpc_stats_t *
+bitcoinrpc_stats_nonstandard_(struct bitcoinrpc_stats_table_ *t, const char *name)
+{
+  size_t h = bitcoinrpc_stats_hash_(name);
+  size_t len = strlen(name);
+  char *copy = NULL;
+  char *taken = NULL;
+
+  for (size_t k = 0; k < BITCOINRPC_STATS_NONSTANDARD_; k++)
+    {
+      bitcoinrpc_stats_t *s = &t->nonstandard[(h + k) % BITCOINRPC_STATS_NONSTANDARD_];
+
+      taken = (char *)s->name;
+      if (NULL == taken)
+        {
+          /* the user's string may go away: keep a copy */
+          if (NULL == copy)
+            {
+              copy = bitcoinrpc_global_allocfunc(len + 1);
+              if (NULL == copy)
+                break;
+              memcpy(copy, name, len + 1);
+            }
+          if (__sync_bool_compare_and_swap(&s->name, NULL, copy))
+            return s;
+          taken = (char *)s->name;    /* another thread has been quicker */
+        }
+      if (strcmp(taken, name) == 0)
+        {
+          if (NULL != copy)
+            bitcoinrpc_global_freefunc(copy);
+          return s;
+        }
+    }
+
+  if (NULL != copy)
+    bitcoinrpc_global_freefunc(copy);
+  return &t->by_method[BITCOINRPC_METHOD_NONSTANDARD];
+}
+
+
+void
+bitcoinrpc_stats_record_(bitcoinrpc_cl_t *cl, size_t n,
+                         bitcoinrpc_method_t **methods,
+                         bitcoinrpc_resp_t **resps,
+                         BITCOINRPCEcode code, double seconds)
+{
+  struct bitcoinrpc_stats_table_ *t = cl->stats;
+  bitcoinrpc_stats_t *s = NULL;
+  unsigned long long us = (seconds > 0) ? (unsigned long long)(seconds * 1e6) : 0;
+  size_t bucket = bitcoinrpc_stats_bucket_(us);
+
+  if (NULL == t)
+    return;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_method_t *m = methods[i];
+
+      if (BITCOINRPC_METHOD_NONSTANDARD == m->m && NULL != m->mstr)
+        s = bitcoinrpc_stats_nonstandard_(t, m->mstr);
+      else if ((size_t)m->m < BITCOINRPC_STATS_METHODS_)
+        s = &t->by_method[m->m];
+      else
+        continue;
+
+      __sync_add_and_fetch(&s->calls, 1);
+      __sync_add_and_fetch(&s->latency[bucket], 1);
+      __sync_add_and_fetch(&s->req_bytes,
+                           (unsigned long long)bitcoinrpc_method_post_bytes_(m));
+
+      if (BITCOINRPCE_OK == code && NULL != resps)
+        {
+          __sync_add_and_fetch(&s->resp_bytes, (unsigned long long)resps[i]->bytes);
+
+          /* the call has succeeded, but the server reports an error */
+          json_t *jerr = json_object_get(resps[i]->json, "error");
+          if (NULL != jerr && !json_is_null(jerr))
+            __sync_add_and_fetch(&s->errors[BITCOINRPCE_SERV], 1);
+        }
+      else if ((size_t)code < BITCOINRPC_STATS_ECODES)
+        {
+          __sync_add_and_fetch(&s->errors[code], 1);
+        }
+    }
+}
+
+
+void
+bitcoinrpc_stats_free_table_(struct bitcoinrpc_stats_table_ *t)
+{
+  if (NULL == t)
+    return;
+
+  for (size_t k = 0; k < BITCOINRPC_STATS_NONSTANDARD_; k++)
+    if (NULL != t->nonstandard[k].name)
+      bitcoinrpc_global_freefunc((char *)t->nonstandard[k].name);
+  bitcoinrpc_global_freefunc(t);
+}
+
+
+/* Copy the counters of src (updated concurrently) to dst */
+static void
+bitcoinrpc_stats_load_(bitcoinrpc_stats_t *dst, bitcoinrpc_stats_t *src)
+{
+  dst->m = src->m;
+  dst->name = src->name;
+  dst->calls = __sync_fetch_and_add(&src->calls, 0);
+  dst->req_bytes = __sync_fetch_and_add(&src->req_bytes, 0);
+  dst->resp_bytes = __sync_fetch_and_add(&src->resp_bytes, 0);
+  for (size_t k = 0; k < BITCOINRPC_STATS_ECODES; k++)
+    dst->errors[k] = __sync_fetch_and_add(&src->errors[k], 0);
+  for (size_t k = 0; k < BITCOINRPC_STATS_BUCKETS; k++)
+    dst->latency[k] = __sync_fetch_and_add(&src->latency[k], 0);
+}
+
+
+static void
+bitcoinrpc_stats_zero_(bitcoinrpc_stats_t *s)
+{
+  __sync_and_and_fetch(&s->calls, 0);
+  __sync_and_and_fetch(&s->req_bytes, 0);
+  __sync_and_and_fetch(&s->resp_bytes, 0);
+  for (size_t k = 0; k < BITCOINRPC_STATS_ECODES; k++)
+    __sync_and_and_fetch(&s->errors[k], 0);
+  for (size_t k = 0; k < BITCOINRPC_STATS_BUCKETS; k++)
+    __sync_and_and_fetch(&s->latency[k], 0);
+}
+
+double
+bitcoinrpc_stats_method_percentile_(bitcoinrpc_cl_t *cl, BITCOINRPC_METHOD m,
+                                    double q, unsigned long long *calls)
+{
+  bitcoinrpc_stats_t s;
+
+  if (NULL == cl->stats || (size_t)m >= BITCOINRPC_STATS_METHODS_)
+    return -1.0;
+
+  bitcoinrpc_stats_load_(&s, &cl->stats->by_method[m]);
+  *calls = s.calls;
+
+  return bitcoinrpc_stats_percentile(&s, q);
+}
+
+
+/* ------------------------------------------------------------------------ */
+
+BITCOINRPCEcode
+bitcoinrpc_cl_enable_stats(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_stats_table_ *t = NULL;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+
+  if (NULL != cl->stats)
+    return BITCOINRPCE_OK;
+
+  t = bitcoinrpc_global_allocfunc(sizeof *t);
+  if (NULL == t)
+    return BITCOINRPCE_ALLOC;
+  memset(t, 0, sizeof *t);
+  for (size_t k = 0; k < BITCOINRPC_STATS_METHODS_; k++)
+    {
+      t->by_method[k].m = (BITCOINRPC_METHOD)k;
+      t->by_method[k].name = bitcoinrpc_method_name_((BITCOINRPC_METHOD)k);
+    }
+  for (size_t k = 0; k < BITCOINRPC_STATS_NONSTANDARD_; k++)
+    t->nonstandard[k].m = BITCOINRPC_METHOD_NONSTANDARD;
+
+  if (!__sync_bool_compare_and_swap(&cl->stats, NULL, t))
+    bitcoinrpc_global_freefunc(t);
+
+  return BITCOINRPCE_OK;
+}
+
+
+bitcoinrpc_stats_t *
+bitcoinrpc_cl_get_stats(bitcoinrpc_cl_t *cl, size_t *n)
+{
+  struct bitcoinrpc_stats_table_ *t = NULL;
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t k = 0;
+
+  if (NULL == cl || NULL == n || NULL == cl->stats)
+    return NULL;
+  t = cl->stats;
+
+  stats = bitcoinrpc_global_allocfunc((BITCOINRPC_STATS_METHODS_ + BITCOINRPC_STATS_NONSTANDARD_)
+                                      * sizeof *stats);
+  if (NULL == stats)
+    return NULL;
+
+  for (size_t i = 0; i < BITCOINRPC_STATS_METHODS_; i++)
+    if (__sync_fetch_and_add(&t->by_method[i].calls, 0) > 0)
+      bitcoinrpc_stats_load_(&stats[k++], &t->by_method[i]);
+  for (size_t i = 0; i < BITCOINRPC_STATS_NONSTANDARD_; i++)
+    if (NULL != t->nonstandard[i].name
+        && __sync_fetch_and_add(&t->nonstandard[i].calls, 0) > 0)
+      bitcoinrpc_stats_load_(&stats[k++], &t->nonstandard[i]);
+  *n = k;
+
+  return stats;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_cl_reset_stats(bitcoinrpc_cl_t *cl)
+{
+  struct bitcoinrpc_stats_table_ *t = NULL;
+
+  if (NULL == cl)
+    return BITCOINRPCE_ARG;
+  t = cl->stats;
+  if (NULL == t)
+    return BITCOINRPCE_OK;
+
+  for (size_t i = 0; i < BITCOINRPC_STATS_METHODS_; i++)
+    bitcoinrpc_stats_zero_(&t->by_method[i]);
+  for (size_t i = 0; i < BITCOINRPC_STATS_NONSTANDARD_; i++)
+    bitcoinrpc_stats_zero_(&t->nonstandard[i]);
+
+  return BITCOINRPCE_OK;
+}
+
+
+BITCOINRPCEcode
+bitcoinrpc_stats_free(bitcoinrpc_stats_t *stats)
+{
+  if (NULL == stats)
+    return BITCOINRPCE_ARG;
+
+  bitcoinrpc_global_freefunc(stats);
+
+  return BITCOINRPCE_OK;
+}
+
+
+double
+bitcoinrpc_stats_percentile(const bitcoinrpc_stats_t *stats, double q)
+{
+  unsigned long long total = 0;
+  unsigned long long rank, seen = 0;
+
+  if (NULL == stats || q < 0.0 || q > 1.0)
+    return -1.0;
+
+  for (size_t k = 0; k < BITCOINRPC_STATS_BUCKETS; k++)
+    total += stats->latency[k];
+  if (0 == total)
+    return 0.0;
+
+  rank = (unsigned long long)(q * (double)total);
+  if (rank >= total)
+    rank = total - 1;
+  for (size_t k = 0; k < BITCOINRPC_STATS_BUCKETS; k++)
+    {
+      seen += stats->latency[k];
+      if (seen > rank)
+        return bitcoinrpc_stats_bucket_max_(k) * 1e-6;
+    }
+
+  return bitcoinrpc_stats_bucket_max_(BITCOINRPC_STATS_BUCKETS - 1) * 1e-6;
+}
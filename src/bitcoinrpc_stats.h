@@ -0,0 +1,76 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+
+/*
+   Statistics of the calls made by a client, per method
+ */
+
+#ifndef BITCOINRPC_STATS_H_5d2b7e90_61c4_4f0a_b8d3_9a47c1e2f6b5
+#define BITCOINRPC_STATS_H_5d2b7e90_61c4_4f0a_b8d3_9a47c1e2f6b5
+
+#include "bitcoinrpc.h"
+
+#define BITCOINRPC_STATS_METHODS_ (BITCOINRPC_METHOD_WALLETPASSPHRASECHANGE + 1)
+
+/* Nonstandard names kept apart; the others are counted together */
+#define BITCOINRPC_STATS_NONSTANDARD_ 64
+
+/*
+   The counters are updated with atomic operations, so calls made from many
+   threads need no lock.  by_method[BITCOINRPC_METHOD_NONSTANDARD] counts the
+   nonstandard methods which do not fit in nonstandard[].
+ */
+struct bitcoinrpc_stats_table_ {
+  bitcoinrpc_stats_t by_method[BITCOINRPC_STATS_METHODS_];
+  bitcoinrpc_stats_t nonstandard[BITCOINRPC_STATS_NONSTANDARD_];   /* name != NULL, if taken */
+};
+
+
+/*
+   Record a call of n methods which has ended with code, after seconds.
+   Does nothing, if the statistics of the client are not enabled.
+   resps is NULL, if the responses have not been kept: their sizes and
+   the errors reported by the server are not counted then.
+ */
+void
+bitcoinrpc_stats_record_(bitcoinrpc_cl_t *cl, size_t n,
+                         bitcoinrpc_method_t **methods,
+                         bitcoinrpc_resp_t **resps,
+                         BITCOINRPCEcode code, double seconds);
+
+/*
+   The latency percentile q of the calls of the (standard) method m recorded
+   so far, and the number of them in calls.  Return -1, if the statistics of
+   the client are not enabled.
+ */
+double
+bitcoinrpc_stats_method_percentile_(bitcoinrpc_cl_t *cl, BITCOINRPC_METHOD m,
+                                    double q, unsigned long long *calls);
+
+void
+bitcoinrpc_stats_free_table_(struct bitcoinrpc_stats_table_ *table);
+
+#endif /* BITCOINRPC_STATS_H_5d2b7e90_61c4_4f0a_b8d3_9a47c1e2f6b5 */
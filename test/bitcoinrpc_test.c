@@ -189,6 +189,8 @@ static char * all_tests(cmdline_options_t o)
   BITCOINRPC_RUN_TEST(resp, o, NULL);
   BITCOINRPC_RUN_TEST(call, o, NULL);
   BITCOINRPC_RUN_TEST(calln, o, NULL);
+  BITCOINRPC_RUN_TEST(async, o, NULL);
+  BITCOINRPC_RUN_TEST(pool, o, NULL);
   return 0;
 }
 
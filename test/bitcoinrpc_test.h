@@ -102,6 +102,8 @@ BITCOINRPC_TESTU(method);
 BITCOINRPC_TESTU(resp);
 BITCOINRPC_TESTU(call);
 BITCOINRPC_TESTU(calln);
+BITCOINRPC_TESTU(async);
+BITCOINRPC_TESTU(pool);
 
 
 #endif /* BITCOINRPC_TEST_H_fbc8b015_1d8d_4c5c_8ec1_b4ca0a8ce138 */
@@ -0,0 +1,337 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <jansson.h>
+
+#include "../src/bitcoinrpc.h"
+#include "bitcoinrpc_test.h"
+
+
+struct async_count {
+  size_t ok;
+  size_t failed;
+};
+
+
+static void
+async_getconnectioncount_cb(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+                            bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e,
+                            void *userdata)
+{
+  struct async_count *c = (struct async_count*)userdata;
+  json_t *j = NULL;
+
+  (void)cl;
+  (void)method;
+
+  if (e->code != BITCOINRPCE_OK)
+    {
+      c->failed++;
+      return;
+    }
+
+  j = bitcoinrpc_resp_get(resp);
+  if (json_is_integer(json_object_get(j, "result")))
+    c->ok++;
+  else
+    c->failed++;
+  json_decref(j);
+}
+
+
+BITCOINRPC_TESTU(async_getconnectioncount200)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 200;
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)testdata;
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  struct async_count c = { 0, 0 };
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+
+      BITCOINRPC_ASSERT(bitcoinrpc_call_async(cl, m[i], r[i],
+                                              async_getconnectioncount_cb,
+                                              &c) == BITCOINRPCE_OK,
+                        "cannot submit an asynchronous call");
+    }
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_run(cl) == BITCOINRPCE_OK,
+                    "cannot perform asynchronous calls");
+
+  BITCOINRPC_ASSERT(c.failed == 0,
+                    "at least one asynchronous call failed");
+  BITCOINRPC_ASSERT(c.ok == n,
+                    "not every callback has been called");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Submit a new call from the callback, until the counter reaches zero */
+struct async_chain {
+  size_t left;
+  size_t ok;
+};
+
+
+static void
+async_chain_cb(bitcoinrpc_cl_t *cl, bitcoinrpc_method_t *method,
+               bitcoinrpc_resp_t *resp, bitcoinrpc_err_t *e,
+               void *userdata)
+{
+  struct async_chain *c = (struct async_chain*)userdata;
+
+  if (e->code == BITCOINRPCE_OK)
+    c->ok++;
+
+  if (--c->left > 0)
+    bitcoinrpc_call_async(cl, method, resp, async_chain_cb, c);
+}
+
+
+BITCOINRPC_TESTU(async_chain)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)testdata;
+  bitcoinrpc_method_t *m = NULL;
+  bitcoinrpc_resp_t *r = NULL;
+  struct async_chain c = { 17, 0 };
+  size_t pending = 1;
+
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(r != NULL,
+                    "cannot initialise a new response");
+
+  BITCOINRPC_ASSERT(bitcoinrpc_call_async(cl, m, r, async_chain_cb, &c)
+                    == BITCOINRPCE_OK,
+                    "cannot submit an asynchronous call");
+
+  while (pending > 0)
+    {
+      BITCOINRPC_ASSERT(bitcoinrpc_cl_poll(cl, 100, &pending) == BITCOINRPCE_OK,
+                        "cannot poll the client");
+    }
+
+  BITCOINRPC_ASSERT(c.left == 0 && c.ok == 17,
+                    "chained asynchronous calls failed");
+
+  bitcoinrpc_resp_free(r);
+  bitcoinrpc_method_free(m);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* A tiny event loop based on poll() */
+#define ASYNC_EVENT_MAXFD 64
+
+struct async_event_loop {
+  struct pollfd fds[ASYNC_EVENT_MAXFD];
+  nfds_t nfds;
+  long timeout_ms;      /* -1 if the timer is disarmed */
+};
+
+
+static void
+async_event_socket_cb(bitcoinrpc_cl_t *cl, int fd, int what, void *userdata)
+{
+  struct async_event_loop *l = (struct async_event_loop*)userdata;
+  nfds_t i;
+
+  (void)cl;
+
+  for (i = 0; i < l->nfds; i++)
+    if (l->fds[i].fd == fd)
+      break;
+
+  if (what == BITCOINRPC_SOCKET_REMOVE)
+    {
+      if (i < l->nfds)
+        l->fds[i] = l->fds[--l->nfds];
+      return;
+    }
+
+  if (i == l->nfds)
+    {
+      if (l->nfds == ASYNC_EVENT_MAXFD)
+        abort();
+      l->nfds++;
+    }
+  l->fds[i].fd = fd;
+  l->fds[i].events = 0;
+  l->fds[i].revents = 0;
+  if (what & BITCOINRPC_SOCKET_IN)
+    l->fds[i].events |= POLLIN;
+  if (what & BITCOINRPC_SOCKET_OUT)
+    l->fds[i].events |= POLLOUT;
+}
+
+
+static void
+async_event_timer_cb(bitcoinrpc_cl_t *cl, long timeout_ms, void *userdata)
+{
+  struct async_event_loop *l = (struct async_event_loop*)userdata;
+
+  (void)cl;
+  l->timeout_ms = timeout_ms;
+}
+
+
+BITCOINRPC_TESTU(async_event_loop)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 50;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  struct async_count c = { 0, 0 };
+  struct async_event_loop l;
+  size_t pending = n;
+
+  l.nfds = 0;
+  l.timeout_ms = -1;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  bitcoinrpc_cl_set_async_maxconn(cl, 8);
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_event_callbacks(cl, async_event_socket_cb,
+                                                      async_event_timer_cb, &l)
+                    == BITCOINRPCE_OK,
+                    "cannot set event callbacks");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(m[i] != NULL && r[i] != NULL,
+                        "cannot initialise a new method or response");
+      BITCOINRPC_ASSERT(bitcoinrpc_call_async(cl, m[i], r[i],
+                                              async_getconnectioncount_cb,
+                                              &c) == BITCOINRPCE_OK,
+                        "cannot submit an asynchronous call");
+    }
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_run(cl) == BITCOINRPCE_ERR,
+                    "polling should be disabled in the event-driven mode");
+
+  while (pending > 0)
+    {
+      int k = poll(l.fds, l.nfds, (l.timeout_ms < 0) ? 1000 : (int)l.timeout_ms);
+      BITCOINRPC_ASSERT(k >= 0, "poll() failed");
+
+      if (k == 0)
+        {
+          l.timeout_ms = -1;
+          BITCOINRPC_ASSERT(bitcoinrpc_cl_socket_action(cl, BITCOINRPC_SOCKET_TIMEOUT,
+                                                        0, &pending)
+                            == BITCOINRPCE_OK,
+                            "socket action on timeout failed");
+          continue;
+        }
+
+      /* the callbacks may change l.fds, so collect the events first */
+      struct pollfd ready[ASYNC_EVENT_MAXFD];
+      nfds_t nready = 0;
+      for (nfds_t i = 0; i < l.nfds; i++)
+        if (l.fds[i].revents)
+          ready[nready++] = l.fds[i];
+
+      for (nfds_t i = 0; i < nready; i++)
+        {
+          int ev = 0;
+          if (ready[i].revents & (POLLIN | POLLERR | POLLHUP))
+            ev |= BITCOINRPC_SOCKET_IN;
+          if (ready[i].revents & POLLOUT)
+            ev |= BITCOINRPC_SOCKET_OUT;
+          BITCOINRPC_ASSERT(bitcoinrpc_cl_socket_action(cl, ready[i].fd, ev, &pending)
+                            == BITCOINRPCE_OK,
+                            "socket action failed");
+        }
+    }
+
+  BITCOINRPC_ASSERT(c.failed == 0 && c.ok == n,
+                    "asynchronous calls in the event-driven mode failed");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+  bitcoinrpc_cl_free(cl);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+BITCOINRPC_TESTU(async)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+
+  /* stay within bitcoind's default -rpcworkqueue */
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_async_maxconn(cl, 8) == BITCOINRPCE_OK,
+                    "cannot limit the number of connections");
+
+  BITCOINRPC_RUN_TEST(async_getconnectioncount200, o, cl);
+  BITCOINRPC_RUN_TEST(async_chain, o, cl);
+  BITCOINRPC_RUN_TEST(async_event_loop, o, NULL);
+
+  bitcoinrpc_cl_free(cl);
+  cl = NULL;
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
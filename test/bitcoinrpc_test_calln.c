@@ -29,7 +29,12 @@
 #include <jansson.h>
 
 #include "../src/bitcoinrpc.h"
+#include "../src/bitcoinrpc_buf.h"
+#include "../src/bitcoinrpc_call.h"
+#include "../src/bitcoinrpc_cl.h"
+#include "../src/bitcoinrpc_flight.h"
 #include "../src/bitcoinrpc_method.h"
+#include "../src/bitcoinrpc_resp.h"
 #include "bitcoinrpc_test.h"
 
 
@@ -323,6 +328,892 @@ BITCOINRPC_TESTU(calln_getbalance99_minconf)
 }
 
 
+BITCOINRPC_TESTU(calln_counter_ids)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 13;
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)testdata;
+
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  bitcoinrpc_err_t e;
+  json_t *j = NULL;
+  const uuid_t null_uuid = { 0 };
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_idmode(cl, BITCOINRPC_ID_COUNTER) == BITCOINRPCE_OK,
+                    "cannot switch to integer ids");
+
+  /* twice, to see the ids change */
+  for (int k = 0; k < 2; k++)
+    {
+      bitcoinrpc_calln(cl, n, m, r, &e);
+      BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                        "cannot perform a call with integer ids");
+
+      for (size_t i = 0; i < n; i++)
+        {
+          j = bitcoinrpc_resp_get(r[i]);
+          BITCOINRPC_ASSERT(json_is_integer(json_object_get(j, "id")),
+                            "the response id is not an integer");
+          BITCOINRPC_ASSERT(json_is_integer(json_object_get(j, "result")),
+                            "getconnectioncount value is not an integer");
+          json_decref(j);
+
+          BITCOINRPC_ASSERT(bitcoinrpc_resp_check(r[i], m[i]) == BITCOINRPCE_OK,
+                            "bitcoinrpc_resp_check fails with integer ids");
+          BITCOINRPC_ASSERT(memcmp(r[i]->uuid, null_uuid, sizeof null_uuid) == 0,
+                            "a response with an integer id has got a UUID");
+        }
+    }
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_idmode(cl, BITCOINRPC_ID_UUID) == BITCOINRPCE_OK,
+                    "cannot switch back to UUIDs");
+
+  bitcoinrpc_call(cl, m[0], r[0], &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call after switching back to UUIDs");
+  j = bitcoinrpc_resp_get(r[0]);
+  BITCOINRPC_ASSERT(json_is_string(json_object_get(j, "id")),
+                    "the response id is not a UUID");
+  json_decref(j);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Every response of a batch gets the timings of the call */
+BITCOINRPC_TESTU(calln_timings)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 7;
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)testdata;
+
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  bitcoinrpc_err_t e;
+  bitcoinrpc_timings_t t, t0;
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  bitcoinrpc_resp_get_timings(r[0], &t);
+  BITCOINRPC_ASSERT(t.total == 0.0 && t.prepare == 0.0,
+                    "the timings of a new response are not zero");
+
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+
+  bitcoinrpc_resp_get_timings(r[0], &t0);
+  BITCOINRPC_ASSERT(t0.total > 0.0 && t0.prepare > 0.0 && t0.parse > 0.0,
+                    "the timings have not been recorded");
+  BITCOINRPC_ASSERT(t0.starttransfer <= t0.total && t0.connect <= t0.pretransfer,
+                    "the timings of the transfer are inconsistent");
+
+  for (size_t i = 1; i < n; i++)
+    {
+      bitcoinrpc_resp_get_timings(r[i], &t);
+      BITCOINRPC_ASSERT(memcmp(&t, &t0, sizeof t) == 0,
+                        "the responses of a batch have different timings");
+    }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/*
+   Pass data to the write callback in chunks of size, as curl would,
+   and parse the responses
+ */
+static BITCOINRPCEcode
+calln_feed_(const char *data, size_t size, size_t n,
+            bitcoinrpc_method_t **m, bitcoinrpc_resp_t **r,
+            struct bitcoinrpc_buf_ *recvbuf)
+{
+  struct bitcoinrpc_call_curl_resp_ curl_resp;
+  bitcoinrpc_err_t e;
+  size_t len = strlen(data);
+  size_t k;
+
+  bitcoinrpc_buf_init_(&curl_resp.arena);
+  bitcoinrpc_call_curl_resp_init_(&curl_resp, recvbuf);
+  for (size_t i = 0; i < len; i += k)
+    {
+      k = (len - i < size) ? len - i : size;
+      if (bitcoinrpc_call_write_callback_((char *)data + i, 1, k, &curl_resp) != k)
+        break;
+    }
+
+  bitcoinrpc_call_finish_(NULL,
+                          curl_resp.e.code == BITCOINRPCE_OK ? CURLE_OK : CURLE_WRITE_ERROR,
+                          "", &curl_resp, n, m, r, &e);
+  bitcoinrpc_buf_free_(&curl_resp.arena);
+  return e.code;
+}
+
+
+/*
+   The server may send the responses of a batch back in any order.
+   Feed the routine that parses them with a reversed batch (no server needed).
+ */
+BITCOINRPC_TESTU(calln_reversed1000)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 1000;
+
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  BITCOINRPCEcode ecode;
+  struct bitcoinrpc_buf_ buf;
+  struct bitcoinrpc_buf_ recvbuf;
+  char elem[128];
+  json_t *j = NULL;
+
+  bitcoinrpc_buf_init_(&buf);
+  bitcoinrpc_buf_init_(&recvbuf);
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  /* UUIDs, then integer ids (BITCOINRPC_ID_COUNTER) */
+  for (int counter = 0; counter < 2; counter++)
+    {
+      bitcoinrpc_buf_clear_(&buf);
+      bitcoinrpc_buf_append_(&buf, "[", 1);
+      for (size_t i = n; i-- > 0; )
+        {
+          if (counter)
+            {
+              bitcoinrpc_method_set_id_(m[i], (json_int_t)i + 1);
+              snprintf(elem, sizeof elem, "{\"result\":%zu,\"error\":null,\"id\":%zu}%s",
+                       i, i + 1, i > 0 ? "," : "");
+            }
+          else
+            {
+              bitcoinrpc_method_set_uuid_(m[i]);
+              snprintf(elem, sizeof elem, "{\"result\":%zu,\"error\":null,\"id\":\"%s\"}%s",
+                       i, m[i]->uuid_str, i > 0 ? "," : "");
+            }
+          bitcoinrpc_buf_append_(&buf, elem, strlen(elem));
+        }
+      bitcoinrpc_buf_append_(&buf, "]", 1);
+
+      ecode = calln_feed_(buf.data, 1000, n, m, r, &recvbuf);
+      BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                        "cannot match the responses of a reversed batch");
+
+      for (size_t i = 0; i < n; i++)
+        {
+          j = bitcoinrpc_resp_get(r[i]);
+          BITCOINRPC_ASSERT(json_integer_value(json_object_get(j, "result")) == (json_int_t)i,
+                            "a response has been matched with a wrong method");
+          json_decref(j);
+
+          BITCOINRPC_ASSERT(bitcoinrpc_resp_check(r[i], m[i]) == BITCOINRPCE_OK,
+                            "bitcoinrpc_resp_check fails for a matched response");
+        }
+    }
+
+  /* the same response twice (and another one missing) */
+  bitcoinrpc_method_set_uuid_(m[0]);
+  bitcoinrpc_method_set_uuid_(m[1]);
+  bitcoinrpc_buf_clear_(&buf);
+  snprintf(elem, sizeof elem, "[{\"result\":0,\"error\":null,\"id\":\"%s\"},",
+           m[0]->uuid_str);
+  bitcoinrpc_buf_append_(&buf, elem, strlen(elem));
+  snprintf(elem, sizeof elem, "{\"result\":0,\"error\":null,\"id\":\"%s\"}]",
+           m[0]->uuid_str);
+  bitcoinrpc_buf_append_(&buf, elem, strlen(elem));
+
+  ecode = calln_feed_(buf.data, 1000, 2, m, r, &recvbuf);
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_CHECK,
+                    "a duplicate response id is not detected");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+  bitcoinrpc_buf_free_(&buf);
+  bitcoinrpc_buf_free_(&recvbuf);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/*
+   The responses are parsed while they arrive, in chunks of any size
+   (no server needed).
+ */
+BITCOINRPC_TESTU(calln_stream)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_method_t *m[3];
+  bitcoinrpc_resp_t *r[3];
+  BITCOINRPCEcode ecode;
+  struct bitcoinrpc_buf_ recvbuf;
+  char data[512];
+  json_t *j = NULL;
+
+  const char *bad[] = {
+    "[{\"result\":0,\"error\":null,\"id\":1},,{}]",
+    "[{\"result\":0,\"error\":null,\"id\":1} {}]",
+    "[{\"result\":0,\"error\":null,\"id\":1},]",
+    "[{\"result\":0,\"error\":null,\"id\":1}}]",
+    "[{\"result\":0,\"error\":null,\"id\":1}] x",
+    "[{\"result\":0,\"error\":null,\"id\":1}",
+    "{\"result\":null,\"error\":{\"code\":-32700,\"message\":\"Parse error\"},\"id\":null}",
+  };
+
+  bitcoinrpc_buf_init_(&recvbuf);
+  for (size_t i = 0; i < 3; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+      bitcoinrpc_method_set_id_(m[i], (json_int_t)i + 1);
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  /* brackets, commas and escaped quotes inside strings; whitespace */
+  snprintf(data, sizeof data, "%s",
+           " \r\n[ {\"result\":\"]},[{\\\"\\\\\",\"error\":null,\"id\":3} ,\n"
+           "{\"result\":[[1,{\"a\":\"}\"}],[]],\"error\":null,\"id\":1},\t"
+           "{\"result\":{},\"error\":null,\"id\":2}\n]\n");
+
+  for (size_t size = 1; size <= strlen(data); size++)
+    {
+      ecode = calln_feed_(data, size, 3, m, r, &recvbuf);
+      BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                        "cannot parse a batch sent in chunks");
+
+      j = bitcoinrpc_resp_get(r[2]);
+      BITCOINRPC_ASSERT(strcmp(json_string_value(json_object_get(j, "result")),
+                               "]},[{\"\\") == 0,
+                        "a string has been parsed wrongly");
+      json_decref(j);
+
+      j = bitcoinrpc_resp_get(r[0]);
+      BITCOINRPC_ASSERT(json_array_size(json_object_get(j, "result")) == 2,
+                        "an array has been parsed wrongly");
+      json_decref(j);
+
+      BITCOINRPC_ASSERT(recvbuf.len < strlen(data),
+                        "the data parsed are still kept");
+    }
+
+  for (size_t k = 0; k < sizeof bad / sizeof bad[0]; k++)
+    {
+      for (size_t size = 1; size < 8; size++)
+        {
+          ecode = calln_feed_(bad[k], size, 1, m, r, &recvbuf);
+          BITCOINRPC_ASSERT(ecode != BITCOINRPCE_OK,
+                            "invalid data have been accepted");
+        }
+    }
+
+  for (size_t i = 0; i < 3; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+  bitcoinrpc_buf_free_(&recvbuf);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* The client counts the calls per method, once asked to */
+BITCOINRPC_TESTU(calln_stats)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 5;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  bitcoinrpc_err_t e;
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t nstats = 0;
+  char name[] = "nonstandardmethod";
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_stats(cl, &nstats) == NULL,
+                    "the statistics are not enabled, but there are some");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_stats(cl) == BITCOINRPCE_OK,
+                    "cannot enable statistics");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(i < 3 ? BITCOINRPC_METHOD_GETCONNECTIONCOUNT
+                                          : BITCOINRPC_METHOD_NONSTANDARD);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+      if (i >= 3)
+        bitcoinrpc_method_set_nonstandard(m[i], name);
+
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+  bitcoinrpc_call(cl, m[0], r[0], &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+
+  /* the name is kept by the client */
+  name[0] = 'N';
+  stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+  BITCOINRPC_ASSERT(stats != NULL && nstats == 2,
+                    "wrong number of methods in the statistics");
+  for (size_t k = 0; k < nstats; k++)
+    {
+      bitcoinrpc_stats_t *s = &stats[k];
+
+      if (s->m == BITCOINRPC_METHOD_GETCONNECTIONCOUNT)
+        {
+          BITCOINRPC_ASSERT(s->calls == 4 && strcmp(s->name, "getconnectioncount") == 0,
+                            "wrong statistics of getconnectioncount");
+        }
+      else
+        {
+          BITCOINRPC_ASSERT(s->m == BITCOINRPC_METHOD_NONSTANDARD && s->calls == 2
+                            && strcmp(s->name, "nonstandardmethod") == 0,
+                            "wrong statistics of a nonstandard method");
+        }
+
+      unsigned long long h = 0;
+      for (size_t b = 0; b < BITCOINRPC_STATS_BUCKETS; b++)
+        h += s->latency[b];
+      BITCOINRPC_ASSERT(h == s->calls,
+                        "the histogram does not count every call");
+      BITCOINRPC_ASSERT(s->req_bytes > 0 && s->resp_bytes > 0,
+                        "the bytes have not been counted");
+      BITCOINRPC_ASSERT(s->errors[BITCOINRPCE_SERV] == 0 && s->errors[BITCOINRPCE_CURLE] == 0,
+                        "errors have been counted");
+
+      double p50 = bitcoinrpc_stats_percentile(s, 0.5);
+      double p99 = bitcoinrpc_stats_percentile(s, 0.99);
+      BITCOINRPC_ASSERT(p50 > 0.0 && p50 <= p99,
+                        "wrong percentiles of the latency");
+    }
+  bitcoinrpc_stats_free(stats);
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_reset_stats(cl) == BITCOINRPCE_OK,
+                    "cannot reset the statistics");
+  stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+  BITCOINRPC_ASSERT(stats != NULL && nstats == 0,
+                    "the statistics have not been reset");
+  bitcoinrpc_stats_free(stats);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+  bitcoinrpc_cl_free(cl);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Results which do not change are served from the cache, once enabled */
+BITCOINRPC_TESTU(calln_cache)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 4;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  bitcoinrpc_err_t e;
+  bitcoinrpc_cachestats_t cs;
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t nstats = 0;
+  unsigned long long sent = 0;
+  size_t one;
+  const char *scripts[] = { "51", "52", NULL, "51" };   /* one is not cached */
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_cachestats(cl, &cs) == BITCOINRPCE_ERR,
+                    "the cache is not enabled, but there are its counters");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_cache(cl, 1 << 20) == BITCOINRPCE_OK,
+                    "cannot enable the cache");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_cache(cl, 1 << 20) == BITCOINRPCE_ERR,
+                    "the cache enabled twice");
+  bitcoinrpc_cl_enable_stats(cl);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      json_t *params = json_pack("[s]", scripts[i] ? scripts[i] : "");
+      m[i] = scripts[i] ? bitcoinrpc_method_init_params(BITCOINRPC_METHOD_DECODESCRIPT, params)
+                        : bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      json_decref(params);
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(m[i] != NULL && r[i] != NULL,
+                        "cannot initialise a new method or response");
+    }
+
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+  bitcoinrpc_cl_get_cachestats(cl, &cs);
+  BITCOINRPC_ASSERT(cs.hits == 0 && cs.misses == 3 && cs.entries == 2 && cs.bytes > 0,
+                    "wrong counters of the cache after a call");
+  one = cs.bytes / 2;
+
+  /* the same again: only getconnectioncount goes to the server */
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+  bitcoinrpc_cl_get_cachestats(cl, &cs);
+  BITCOINRPC_ASSERT(cs.hits == 3 && cs.misses == 3 && cs.entries == 2,
+                    "the results have not been served from the cache");
+  for (size_t i = 0; i < n; i++)
+    {
+      json_t *j = bitcoinrpc_resp_get_borrowed(r[i]);
+      BITCOINRPC_ASSERT(bitcoinrpc_resp_check(r[i], m[i]) == BITCOINRPCE_OK,
+                        "a cached response does not match its method");
+      BITCOINRPC_ASSERT(json_object_get(j, "result") != NULL
+                        && json_is_null(json_object_get(j, "error")),
+                        "a cached response is not complete");
+    }
+  /* all three sent with the first batch (a repeated miss is not merged) */
+  stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+  for (size_t k = 0; k < nstats; k++)
+    if (stats[k].m == BITCOINRPC_METHOD_DECODESCRIPT)
+      sent = stats[k].calls;
+  bitcoinrpc_stats_free(stats);
+  BITCOINRPC_ASSERT(sent == 3,
+                    "the server has been asked for a cached result");
+
+  /* a response served from the cache can be changed: it has a copy of its own */
+  json_object_set_new(json_object_get(bitcoinrpc_resp_get_borrowed(r[0]), "result"),
+                      "changed", json_true());
+
+  /* a hit only, no transfer */
+  bitcoinrpc_call(cl, m[0], r[0], &e);
+  bitcoinrpc_cl_get_cachestats(cl, &cs);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK && cs.hits == 4,
+                    "a single call has not been served from the cache");
+  BITCOINRPC_ASSERT(NULL == json_object_get(json_object_get(bitcoinrpc_resp_get_borrowed(r[0]),
+                                                            "result"), "changed"),
+                    "a change of a response has got into the cache");
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_clear_cache(cl) == BITCOINRPCE_OK,
+                    "cannot clear the cache");
+  bitcoinrpc_cl_get_cachestats(cl, &cs);
+  BITCOINRPC_ASSERT(cs.hits == 0 && cs.entries == 0 && cs.bytes == 0,
+                    "the cache has not been cleared");
+  bitcoinrpc_cl_free(cl);
+
+  /* room for one result: the least recently used one is dropped */
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  bitcoinrpc_cl_enable_cache(cl, one + one / 2);
+  bitcoinrpc_call(cl, m[0], r[0], &e);
+  bitcoinrpc_call(cl, m[1], r[1], &e);
+  bitcoinrpc_call(cl, m[0], r[0], &e);
+  bitcoinrpc_cl_get_cachestats(cl, &cs);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK && cs.entries == 1
+                    && cs.hits == 0 && cs.misses == 3,
+                    "wrong eviction from the cache");
+  bitcoinrpc_cl_free(cl);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/*
+   The memory of a call is counted and can be capped
+   (if the allocations are counted, see: test_global_accounting()).
+ */
+BITCOINRPC_TESTU(calln_memstats)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 100;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m[n];
+  bitcoinrpc_resp_t *r[n];
+  bitcoinrpc_err_t e;
+  bitcoinrpc_memstats_t mc, mr, mr1;
+
+  if (bitcoinrpc_global_get_memstats(&mc) != BITCOINRPCE_OK)
+    BITCOINRPC_TESTU_RETURN(0);
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_memstats(cl, &mc) == BITCOINRPCE_OK,
+                    "cannot get the memory of the client");
+  BITCOINRPC_ASSERT(mc.allocs > 0 && mc.in_use > 0,
+                    "the connection of the client has not been counted");
+
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(r[i] != NULL,
+                        "cannot initialise a new response");
+    }
+
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call");
+  bitcoinrpc_resp_get_memstats(r[0], &mr);
+  bitcoinrpc_resp_get_memstats(r[n - 1], &mr1);
+  BITCOINRPC_ASSERT(mr.allocs >= n && mr.peak > 0 && mr.peak >= mr.in_use,
+                    "the memory of the call has not been counted");
+  BITCOINRPC_ASSERT(memcmp(&mr, &mr1, sizeof mr) == 0,
+                    "the responses of a batch have different memory counts");
+
+  bitcoinrpc_cl_get_memstats(cl, &mc);
+  BITCOINRPC_ASSERT(mc.bytes >= mr.bytes,
+                    "the memory of the call has not been charged to the client");
+
+  /* the same call does not fit into half of its peak */
+  bitcoinrpc_cl_set_call_memlimit(cl, (size_t)mr.peak / 2);
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code != BITCOINRPCE_OK,
+                    "the memory limit of a call has been exceeded");
+  bitcoinrpc_cl_set_call_memlimit(cl, 0);
+  bitcoinrpc_calln(cl, n, m, r, &e);
+  BITCOINRPC_ASSERT(e.code == BITCOINRPCE_OK,
+                    "cannot perform a call without the memory limit");
+
+  /* the responses outlive the client */
+  bitcoinrpc_cl_free(cl);
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_resp_free(r[i]);
+      bitcoinrpc_method_free(m[i]);
+    }
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/*
+   A large batch split into chunks, sent over many connections at once,
+   with a pool of connections or in the thread-safe mode
+ */
+BITCOINRPC_TESTU(calln_chunks)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 1000;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t **m = NULL;
+  bitcoinrpc_resp_t **r = NULL;
+  bitcoinrpc_err_t e;
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t nstats = 0;
+  unsigned long long sent;
+  json_t *j = NULL;
+  int ok;
+
+  m = malloc(n * sizeof *m);
+  r = malloc(n * sizeof *r);
+  BITCOINRPC_ASSERT(m != NULL && r != NULL,
+                    "cannot allocate memory");
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init((i % 2) ? BITCOINRPC_METHOD_GETBESTBLOCKHASH
+                                            : BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      r[i] = bitcoinrpc_resp_init();
+      BITCOINRPC_ASSERT(m[i] != NULL && r[i] != NULL,
+                        "cannot initialise a new method or response");
+    }
+
+  for (int threadsafe = 0; threadsafe < 2; threadsafe++)
+    {
+      if (threadsafe)
+        cl = bitcoinrpc_cl_init_threadsafe(o.user, o.pass, o.addr, o.port);
+      else
+        cl = bitcoinrpc_cl_init_pool(o.user, o.pass, o.addr, o.port, 4);
+      BITCOINRPC_ASSERT(cl != NULL,
+                        "cannot initialise a new client");
+      BITCOINRPC_ASSERT(bitcoinrpc_cl_set_chunking(cl, 64, 0) == BITCOINRPCE_ARG,
+                        "chunks accepted with none in flight");
+      BITCOINRPC_ASSERT(bitcoinrpc_cl_set_chunking(cl, 64, 4) == BITCOINRPCE_OK,
+                        "cannot set the chunks");
+      bitcoinrpc_cl_set_idmode(cl, BITCOINRPC_ID_COUNTER);
+      bitcoinrpc_cl_enable_stats(cl);
+      bitcoinrpc_cl_enable_limit(cl, 2, 4, 0);
+
+      for (size_t i = 0; i < n; i++)
+        bitcoinrpc_resp_reset(r[i]);
+      BITCOINRPC_ASSERT(bitcoinrpc_calln(cl, n, m, r, &e) == BITCOINRPCE_OK,
+                        "cannot perform a call split into chunks");
+
+      /* every response in its place */
+      for (size_t i = 0; i < n; i++)
+        {
+          j = bitcoinrpc_resp_get(r[i]);
+          ok = (i % 2) ? json_is_string(json_object_get(j, "result"))
+                       : json_is_integer(json_object_get(j, "result"));
+          json_decref(j);
+          BITCOINRPC_ASSERT(ok && bitcoinrpc_resp_check(r[i], m[i]) == BITCOINRPCE_OK,
+                            "a response is out of order");
+        }
+
+      sent = 0;
+      stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+      for (size_t k = 0; k < nstats; k++)
+        sent += stats[k].calls;
+      bitcoinrpc_stats_free(stats);
+      BITCOINRPC_ASSERT(sent == n,
+                        "the methods of the chunks have not been counted once");
+
+      /* the connection of the thread is still usable */
+      BITCOINRPC_ASSERT(bitcoinrpc_call(cl, m[0], r[0], &e) == BITCOINRPCE_OK,
+                        "cannot perform a call after a call split into chunks");
+
+      bitcoinrpc_cl_free(cl);
+    }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      bitcoinrpc_method_free(m[i]);
+      bitcoinrpc_resp_free(r[i]);
+    }
+  free(m);
+  free(r);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/*
+   The response of a call in the single flight, as shared with the calls
+   waiting for it (no server needed)
+ */
+BITCOINRPC_TESTU(calln_flight_share)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m = NULL;
+  bitcoinrpc_resp_t *r = NULL;
+  struct bitcoinrpc_flight_call_ *call = NULL;
+  bitcoinrpc_err_t e, ew;
+  json_t *j = NULL;
+  json_t *old = NULL;
+  int leader = 0;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(cl != NULL && m != NULL && r != NULL,
+                    "cannot initialise a new client, method or response");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_single_flight(cl) == BITCOINRPCE_OK,
+                    "cannot enable the single flight");
+
+  /* the response of an earlier call is still in r */
+  old = json_pack("{s:i, s:n, s:i}", "result", 1, "error", "id", 1);
+  bitcoinrpc_resp_set_json_(r, old);
+
+  for (int failed = 1; failed >= 0; failed--)
+    {
+      call = bitcoinrpc_flight_join_(cl->flight, m, &leader);
+      BITCOINRPC_ASSERT(call != NULL && leader,
+                        "cannot start a new flight");
+      BITCOINRPC_ASSERT(bitcoinrpc_flight_join_(cl->flight, m, &leader) == call && !leader,
+                        "cannot join the flight");
+
+      e.code = failed ? BITCOINRPCE_CURLE : BITCOINRPCE_OK;
+      e.msg[0] = '\0';
+      bitcoinrpc_flight_land_(cl->flight, call, &e, r);
+
+      /* the caller of the leader owns its response */
+      if (!failed)
+        json_object_set_new(old, "result", json_integer(2));
+
+      bitcoinrpc_flight_wait_(cl->flight, call, &ew, r, &j);
+      if (failed)
+        BITCOINRPC_ASSERT(NULL == j && BITCOINRPCE_CURLE == ew.code,
+                          "the response of an earlier call has been shared");
+      else
+        BITCOINRPC_ASSERT(j != old && json_integer_value(json_object_get(j, "result")) == 1,
+                          "the response shared has not been copied");
+      json_decref(j);
+    }
+
+  json_decref(old);
+  bitcoinrpc_resp_free(r);
+  bitcoinrpc_method_free(m);
+  bitcoinrpc_cl_free(cl);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* What the callback of calln_streamed has seen */
+struct calln_seen_ {
+  size_t calls;
+  size_t stop;          /* stop the call after as many responses, if not 0 */
+  char *got;            /* a flag per method */
+  int ok;
+};
+
+
+static int
+calln_stream_cb_(bitcoinrpc_cl_t *cl, size_t i, bitcoinrpc_method_t *method,
+                 bitcoinrpc_resp_t *resp, void *userdata)
+{
+  struct calln_seen_ *seen = userdata;
+  json_t *result = json_object_get(bitcoinrpc_resp_get_borrowed(resp), "result");
+
+  (void)cl;
+  if (seen->got[i] || bitcoinrpc_resp_check(resp, method) != BITCOINRPCE_OK
+      || !((i % 2) ? json_is_string(result) : json_is_integer(result)))
+    seen->ok = 0;
+  seen->got[i] = 1;
+  seen->calls++;
+
+  return seen->stop > 0 && seen->calls == seen->stop;
+}
+
+
+/* The responses of a batch handed to a callback one by one */
+BITCOINRPC_TESTU(calln_streamed)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t n = 1000;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t **m = NULL;
+  bitcoinrpc_err_t e;
+  struct calln_seen_ seen;
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t nstats = 0;
+  unsigned long long sent = 0;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  bitcoinrpc_cl_set_idmode(cl, BITCOINRPC_ID_COUNTER);
+  bitcoinrpc_cl_enable_stats(cl);
+
+  m = malloc(n * sizeof *m);
+  seen.got = calloc(n, 1);
+  BITCOINRPC_ASSERT(m != NULL && seen.got != NULL,
+                    "cannot allocate memory");
+  for (size_t i = 0; i < n; i++)
+    {
+      m[i] = bitcoinrpc_method_init((i % 2) ? BITCOINRPC_METHOD_GETBESTBLOCKHASH
+                                            : BITCOINRPC_METHOD_GETBLOCKCOUNT);
+      BITCOINRPC_ASSERT(m[i] != NULL,
+                        "cannot initialise a new method");
+    }
+
+  BITCOINRPC_ASSERT(bitcoinrpc_calln_stream(cl, n, m, NULL, NULL, &e) == BITCOINRPCE_ARG,
+                    "a streamed call accepted with no callback");
+
+  seen.calls = 0;
+  seen.stop = 0;
+  seen.ok = 1;
+  BITCOINRPC_ASSERT(bitcoinrpc_calln_stream(cl, n, m, calln_stream_cb_, &seen, &e)
+                    == BITCOINRPCE_OK,
+                    "cannot perform a streamed call");
+  BITCOINRPC_ASSERT(seen.calls == n && seen.ok,
+                    "the callback has not got every response once");
+
+  stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+  for (size_t k = 0; k < nstats; k++)
+    sent += stats[k].calls;
+  bitcoinrpc_stats_free(stats);
+  BITCOINRPC_ASSERT(sent == n,
+                    "the methods of a streamed call have not been counted");
+
+  /* the client is still usable after the callback has stopped a call */
+  memset(seen.got, 0, n);
+  seen.calls = 0;
+  seen.stop = 10;
+  BITCOINRPC_ASSERT(bitcoinrpc_calln_stream(cl, n, m, calln_stream_cb_, &seen, &e)
+                    == BITCOINRPCE_ERR,
+                    "a call stopped by the callback has not failed");
+  BITCOINRPC_ASSERT(seen.calls == 10 && seen.ok,
+                    "the callback has been called after it has stopped the call");
+
+  memset(seen.got, 0, n);
+  seen.calls = 0;
+  seen.stop = 0;
+  BITCOINRPC_ASSERT(bitcoinrpc_calln_stream(cl, 1, m, calln_stream_cb_, &seen, &e)
+                    == BITCOINRPCE_OK && 1 == seen.calls && seen.ok,
+                    "cannot stream a single call");
+
+  for (size_t i = 0; i < n; i++)
+    bitcoinrpc_method_free(m[i]);
+  free(m);
+  free(seen.got);
+  bitcoinrpc_cl_free(cl);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
 
 BITCOINRPC_TESTU(calln)
 {
@@ -340,6 +1231,16 @@ BITCOINRPC_TESTU(calln)
   BITCOINRPC_RUN_TEST(calln_settxfee703, o, cl);
   BITCOINRPC_RUN_TEST(calln_getconnectioncount27_settxfee41, o, cl);
   BITCOINRPC_RUN_TEST(calln_getbalance99_minconf, o, cl);
+  BITCOINRPC_RUN_TEST(calln_counter_ids, o, cl);
+  BITCOINRPC_RUN_TEST(calln_timings, o, cl);
+  BITCOINRPC_RUN_TEST(calln_reversed1000, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_stream, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_stats, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_memstats, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_cache, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_flight_share, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_chunks, o, NULL);
+  BITCOINRPC_RUN_TEST(calln_streamed, o, NULL);
 
   bitcoinrpc_cl_free(cl);
   cl = NULL;
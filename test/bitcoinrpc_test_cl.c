@@ -22,9 +22,15 @@
    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 
 #include <jansson.h>
 
@@ -227,11 +233,177 @@ BITCOINRPC_TESTU(client_getparams_edge)
 }
 
 
+/*
+   Calls are balanced among the nodes of a client: here, the server twice
+   and a port nobody listens on, which gets ejected.
+ */
+BITCOINRPC_TESTU(client_nodes)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t ncalls = 30;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m = NULL;
+  bitcoinrpc_resp_t *r = NULL;
+  bitcoinrpc_err_t e;
+  bitcoinrpc_nodestats_t ns[4];
+  size_t n = 4, ok = 0;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_nodestats(cl, ns, &n) == BITCOINRPCE_ERR,
+                    "there are nodes, but none has been added");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_add_node(cl, o.user, o.pass, o.addr, o.port) == BITCOINRPCE_OK
+                    && bitcoinrpc_cl_add_node(cl, o.user, o.pass, "127.0.0.1", 1) == BITCOINRPCE_OK,
+                    "cannot add a node");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_add_node(cl, NULL, o.pass, o.addr, o.port) == BITCOINRPCE_ARG,
+                    "a node without user added");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_ejection(cl, 2, 60.0) == BITCOINRPCE_OK,
+                    "cannot set the ejection of nodes");
+
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(m != NULL && r != NULL,
+                    "cannot initialise a new method or response");
+
+  for (size_t i = 0; i < ncalls; i++)
+    if (bitcoinrpc_call(cl, m, r, &e) == BITCOINRPCE_OK)
+      ok++;
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_nodestats(cl, ns, &n) == BITCOINRPCE_OK && n == 3,
+                    "cannot get the counters of the nodes");
+  BITCOINRPC_ASSERT(ns[2].port == 1 && ns[2].ejected && ns[2].errors == 2
+                    && ns[2].calls == 2 && ok == ncalls - 2,
+                    "the node which fails has not been ejected");
+  BITCOINRPC_ASSERT(ns[0].calls > 0 && ns[1].calls > 0
+                    && ns[0].calls + ns[1].calls == ok
+                    && ns[0].errors == 0 && ns[1].errors == 0,
+                    "the calls have not been balanced");
+  BITCOINRPC_ASSERT(ns[0].ewma > 0 && ns[1].ewma > 0 && ns[2].ewma == 0,
+                    "wrong latencies of the nodes");
+
+  /* the fastest node (of two equally fast ones) */
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_set_balance(cl, BITCOINRPC_BALANCE_EWMA) == BITCOINRPCE_OK,
+                    "cannot set the balancing");
+  for (size_t i = 0; i < ncalls; i++)
+    BITCOINRPC_ASSERT(bitcoinrpc_call(cl, m, r, &e) == BITCOINRPCE_OK,
+                      "a call to an ejected node");
+
+  bitcoinrpc_resp_free(r);
+  bitcoinrpc_method_free(m);
+  bitcoinrpc_cl_free(cl);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* A server which takes connections, but never answers; return its socket */
+static int
+client_stalled_server_(unsigned int *port)
+{
+  struct sockaddr_in sa;
+  socklen_t len = sizeof sa;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (fd < 0)
+    return -1;
+
+  memset(&sa, 0, sizeof sa);
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *)&sa, sizeof sa) != 0 || listen(fd, 16) != 0
+      || getsockname(fd, (struct sockaddr *)&sa, &len) != 0)
+    {
+      close(fd);
+      return -1;
+    }
+  *port = ntohs(sa.sin_port);
+
+  return fd;
+}
+
+
+BITCOINRPC_TESTU(client_hedging)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  const size_t ncalls = 10;
+  const double delay = 0.05;
+  bitcoinrpc_cl_t *cl = NULL;
+  bitcoinrpc_method_t *m = NULL;
+  bitcoinrpc_resp_t *r = NULL;
+  bitcoinrpc_err_t e;
+  bitcoinrpc_nodestats_t ns[2];
+  size_t n = 2;
+  unsigned long long hedged = 0, won = 0;
+  unsigned int port = 0;
+  struct timespec t0, t1;
+  double elapsed;
+  int fd;
+
+  cl = bitcoinrpc_cl_init_params(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_hedged(cl, &hedged, &won) == BITCOINRPCE_ERR,
+                    "hedging not enabled, but there are counters");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_hedging(cl, 1.5, delay) == BITCOINRPCE_ARG,
+                    "a wrong percentile accepted");
+
+  fd = client_stalled_server_(&port);
+  BITCOINRPC_ASSERT(fd >= 0,
+                    "cannot open a socket");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_add_node(cl, o.user, o.pass, "127.0.0.1", port)
+                    == BITCOINRPCE_OK,
+                    "cannot add a node");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_hedging(cl, 0.95, delay) == BITCOINRPCE_OK,
+                    "cannot enable hedging");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_hedging(cl, 0.95, delay) == BITCOINRPCE_ERR,
+                    "hedging enabled twice");
+
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKCOUNT);
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(m != NULL && r != NULL,
+                    "cannot initialise a new method or response");
+
+  /* every other call goes to the node which does not answer */
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (size_t i = 0; i < ncalls; i++)
+    {
+      BITCOINRPC_ASSERT(bitcoinrpc_call(cl, m, r, &e) == BITCOINRPCE_OK,
+                        "a hedged call has failed");
+      BITCOINRPC_ASSERT(bitcoinrpc_resp_check(r, m) == BITCOINRPCE_OK,
+                        "the response does not match the method");
+    }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_hedged(cl, &hedged, &won) == BITCOINRPCE_OK,
+                    "cannot get the counters of hedging");
+  BITCOINRPC_ASSERT(hedged > 0 && hedged < ncalls && won == hedged,
+                    "the calls to the stalled node have not been hedged");
+  BITCOINRPC_ASSERT(elapsed >= hedged * delay && elapsed < 5.0,
+                    "the calls have not been sent again after the delay");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_nodestats(cl, ns, &n) == BITCOINRPCE_OK && n == 2
+                    && 0 == ns[1].errors && 0 == ns[1].outstanding && ns[1].ewma >= delay,
+                    "the stalled node has not been counted as slow");
+
+  bitcoinrpc_resp_free(r);
+  bitcoinrpc_method_free(m);
+  bitcoinrpc_cl_free(cl);
+  close(fd);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
 BITCOINRPC_TESTU(client)
 {
   BITCOINRPC_TESTU_INIT;
   BITCOINRPC_RUN_TEST(client_init, o, NULL);
   BITCOINRPC_RUN_TEST(client_getparams_cmdline, o, NULL);
   BITCOINRPC_RUN_TEST(client_getparams_edge, o, NULL);
+  BITCOINRPC_RUN_TEST(client_nodes, o, NULL);
+  BITCOINRPC_RUN_TEST(client_hedging, o, NULL);
   BITCOINRPC_TESTU_RETURN(0);
 }
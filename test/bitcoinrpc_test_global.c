@@ -51,10 +51,55 @@ BITCOINRPC_TESTU(global_cleanup)
 }
 
 
+/*
+   Count the allocations from now on (the other tests run with it).
+   Nothing has been allocated by the library yet.
+ */
+BITCOINRPC_TESTU(global_accounting)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_memstats_t m0, m1, m2;
+  bitcoinrpc_method_t *m = NULL;
+  json_t *params = NULL;
+
+  BITCOINRPC_ASSERT(bitcoinrpc_global_get_memstats(&m0) == BITCOINRPCE_ERR,
+                    "allocations are counted before they are enabled");
+  BITCOINRPC_ASSERT(bitcoinrpc_global_enable_accounting(1) == BITCOINRPCE_OK,
+                    "cannot enable accounting");
+  BITCOINRPC_ASSERT(bitcoinrpc_global_enable_accounting(1) == BITCOINRPCE_ERR,
+                    "accounting enabled twice");
+  bitcoinrpc_global_get_memstats(&m0);
+
+  /* jansson allocates through the library too */
+  params = json_array();
+  json_array_append_new(params, json_string("00000000000000000000000000000000"));
+  bitcoinrpc_global_get_memstats(&m1);
+  BITCOINRPC_ASSERT(m1.allocs > m0.allocs && m1.in_use > m0.in_use,
+                    "jansson allocations have not been counted");
+
+  m = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_GETBLOCK, params);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  bitcoinrpc_global_get_memstats(&m2);
+  BITCOINRPC_ASSERT(m2.allocs > m1.allocs && m2.bytes > m1.bytes && m2.peak >= m2.in_use,
+                    "the allocations of a method have not been counted");
+
+  bitcoinrpc_method_free(m);
+  json_decref(params);
+  bitcoinrpc_global_get_memstats(&m2);
+  BITCOINRPC_ASSERT(m2.in_use == m0.in_use,
+                    "freed memory is still counted as in use");
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
 BITCOINRPC_TESTU(global)
 {
   BITCOINRPC_TESTU_INIT;
   BITCOINRPC_RUN_TEST(global_init, o, NULL);
+  BITCOINRPC_RUN_TEST(global_accounting, o, NULL);
   BITCOINRPC_RUN_TEST(global_cleanup, o, NULL);
   BITCOINRPC_TESTU_RETURN(0);
 }
@@ -29,6 +29,7 @@
 #include <jansson.h>
 
 #include "../src/bitcoinrpc.h"
+#include "../src/bitcoinrpc_buf.h"
 #include "../src/bitcoinrpc_method.h"
 #include "bitcoinrpc_test.h"
 
@@ -178,11 +179,274 @@ BITCOINRPC_TESTU(method_set_nonstandard)
 
 
 
+BITCOINRPC_TESTU(method_append_post)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  BITCOINRPCEcode ecode;
+  bitcoinrpc_method_t *m = NULL;
+  struct bitcoinrpc_buf_ buf;
+  json_t *params = NULL;
+  json_t *j = NULL;
+
+  params = json_pack("[s, i]", "quote\" and \\ slash", 7);
+  m = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_NONSTANDARD, params);
+  json_decref(params);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+
+  ecode = bitcoinrpc_method_set_nonstandard(m, "name\twith\"escapes");
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                    "cannot set a nonstandard method name");
+
+  bitcoinrpc_buf_init_(&buf);
+
+  /* a UUID */
+  ecode = bitcoinrpc_method_set_uuid_(m);
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                    "cannot set the uuid");
+  ecode = bitcoinrpc_method_append_post_(m, &buf);
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                    "cannot serialise the method");
+  j = json_loadb(buf.data, buf.len, 0, NULL);
+  BITCOINRPC_ASSERT(json_is_object(j),
+                    "the request is not a JSON object");
+  BITCOINRPC_ASSERT(strcmp(json_string_value(json_object_get(j, "jsonrpc")), "2.0") == 0,
+                    "wrong jsonrpc version");
+  BITCOINRPC_ASSERT(strcmp(json_string_value(json_object_get(j, "method")),
+                           "name\twith\"escapes") == 0,
+                    "wrong method name");
+  BITCOINRPC_ASSERT(json_equal(json_object_get(j, "params"), m->params_json),
+                    "wrong params");
+  BITCOINRPC_ASSERT(strcmp(json_string_value(json_object_get(j, "id")), m->uuid_str) == 0,
+                    "wrong uuid");
+  json_decref(j);
+
+  /* an integer id, with no params */
+  bitcoinrpc_method_set_params(m, NULL);
+  ecode = bitcoinrpc_method_set_id_(m, 9007199254740993LL);
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                    "cannot set the id");
+  bitcoinrpc_buf_clear_(&buf);
+  ecode = bitcoinrpc_method_append_post_(m, &buf);
+  BITCOINRPC_ASSERT(ecode == BITCOINRPCE_OK,
+                    "cannot serialise the method");
+  j = json_loadb(buf.data, buf.len, 0, NULL);
+  BITCOINRPC_ASSERT(json_is_object(j),
+                    "the request is not a JSON object");
+  BITCOINRPC_ASSERT(json_is_array(json_object_get(j, "params"))
+                    && json_array_size(json_object_get(j, "params")) == 0,
+                    "params should be an empty array");
+  BITCOINRPC_ASSERT(json_integer_value(json_object_get(j, "id")) == 9007199254740993LL,
+                    "wrong integer id");
+  json_decref(j);
+
+  bitcoinrpc_buf_free_(&buf);
+  bitcoinrpc_method_free(m);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+
+BITCOINRPC_TESTU(method_reset)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_method_t *m = NULL;
+  json_t *params = NULL;
+  char *post = NULL;
+
+  params = json_pack("[s, i]", "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f", 0);
+  m = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_GETBLOCK, params);
+  json_decref(params);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  post = m->post;
+
+  /* a shorter post is written into the same memory */
+  BITCOINRPC_ASSERT(bitcoinrpc_method_reset(m, BITCOINRPC_METHOD_GETBLOCKCOUNT, NULL)
+                    == BITCOINRPCE_OK,
+                    "cannot reset the method");
+  BITCOINRPC_ASSERT(m->post == post,
+                    "the post has been allocated again");
+  BITCOINRPC_ASSERT(m->m == BITCOINRPC_METHOD_GETBLOCKCOUNT && m->params_json == NULL,
+                    "the method has not been reset");
+  BITCOINRPC_ASSERT(strcmp(m->post, "{\"jsonrpc\":\"2.0\",\"method\":\"getblockcount\","
+                           "\"params\":[],\"id\":") == 0,
+                    "wrong post after reset");
+
+  params = json_pack("[i]", 7);
+  BITCOINRPC_ASSERT(bitcoinrpc_method_reset(m, BITCOINRPC_METHOD_GETBLOCKHASH, params)
+                    == BITCOINRPCE_OK,
+                    "cannot reset the method with params");
+  BITCOINRPC_ASSERT(m->params_json != params && json_equal(m->params_json, params),
+                    "the params have not been copied");
+  json_decref(params);
+
+  BITCOINRPC_ASSERT(bitcoinrpc_method_reset(NULL, BITCOINRPC_METHOD_HELP, NULL)
+                    == BITCOINRPCE_ARG,
+                    "a NULL method reset");
+
+  bitcoinrpc_method_free(m);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* The post of m should be the same as of a method made from scratch */
+static int
+method_post_equal_(bitcoinrpc_method_t *m)
+{
+  bitcoinrpc_method_t *m1 = bitcoinrpc_method_init_params(m->m, m->params_json);
+  int eq = m1 != NULL && m1->post_len == m->post_len
+           && strcmp(m1->post, m->post) == 0;
+
+  bitcoinrpc_method_free(m1);
+  return eq;
+}
+
+
+BITCOINRPC_TESTU(method_set_param)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_method_t *m = NULL;
+  json_t *params = NULL;
+  char *post = NULL;
+
+  params = json_pack("[i]", 0);
+  m = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_GETBLOCKHASH, params);
+  json_decref(params);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  post = m->post;
+
+  /* walking the chain */
+  for (json_int_t h = 0; h <= 1000000; h += 9973)
+    {
+      BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_int(m, 0, h) == BITCOINRPCE_OK,
+                        "cannot set an integer parameter");
+      BITCOINRPC_ASSERT(json_integer_value(json_array_get(m->params_json, 0)) == h,
+                        "the parameter has not been set");
+      BITCOINRPC_ASSERT(method_post_equal_(m),
+                        "wrong post after setting an integer parameter");
+    }
+  BITCOINRPC_ASSERT(m->post == post,
+                    "the post has not been updated in place");
+  bitcoinrpc_method_free(m);
+
+  /* slots of many types, the ones after the one set have to move */
+  params = json_pack("[i, s, b, f]", 1, "a", 1, 0.5);
+  m = bitcoinrpc_method_init_params(BITCOINRPC_METHOD_NONSTANDARD, params);
+  json_decref(params);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_int(m, 0, 123456789) == BITCOINRPCE_OK
+                    && bitcoinrpc_method_set_param_str(m, 1, "quote\" and \\") == BITCOINRPCE_OK
+                    && bitcoinrpc_method_set_param_bool(m, 2, 0) == BITCOINRPCE_OK
+                    && bitcoinrpc_method_set_param_real(m, 3, 2.25) == BITCOINRPCE_OK,
+                    "cannot set the parameters");
+  BITCOINRPC_ASSERT(method_post_equal_(m),
+                    "wrong post after setting the parameters");
+  BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_str(m, 0, "") == BITCOINRPCE_OK
+                    && bitcoinrpc_method_set_param_int(m, 1, -1) == BITCOINRPCE_OK,
+                    "cannot change the type of a parameter");
+  BITCOINRPC_ASSERT(method_post_equal_(m),
+                    "wrong post after changing the type of a parameter");
+
+  /* appending, but not beyond the end */
+  BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_int(m, 5, 1) == BITCOINRPCE_ARG,
+                    "a parameter set beyond the end");
+  BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_str(m, 4, "0123456789abcdef0123456789abcdef"
+                                                    "0123456789abcdef0123456789abcdef")
+                    == BITCOINRPCE_OK,
+                    "cannot append a parameter");
+  BITCOINRPC_ASSERT(json_array_size(m->params_json) == 5 && method_post_equal_(m),
+                    "wrong post after appending a parameter");
+  bitcoinrpc_method_free(m);
+
+  /* a method with no params gets an array */
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETBLOCKHASH);
+  BITCOINRPC_ASSERT(m != NULL,
+                    "cannot initialise a new method");
+  BITCOINRPC_ASSERT(bitcoinrpc_method_set_param_int(m, 0, 42) == BITCOINRPCE_OK,
+                    "cannot set the first parameter");
+  BITCOINRPC_ASSERT(json_is_array(m->params_json) && method_post_equal_(m),
+                    "wrong post after setting the first parameter");
+  bitcoinrpc_method_free(m);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Once warmed up, getting and putting objects should not allocate */
+BITCOINRPC_TESTU(method_objpool)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_objpool_t *pool = NULL;
+  bitcoinrpc_method_t *m = NULL, *m1 = NULL;
+  bitcoinrpc_resp_t *r = NULL, *r1 = NULL;
+  bitcoinrpc_memstats_t ms0, ms1;
+  int accounting;
+
+  pool = bitcoinrpc_objpool_init(1);
+  BITCOINRPC_ASSERT(pool != NULL,
+                    "cannot initialise a new pool");
+
+  m = bitcoinrpc_objpool_get_method(pool, BITCOINRPC_METHOD_GETBLOCKCHAININFO, NULL);
+  r = bitcoinrpc_objpool_get_resp(pool);
+  BITCOINRPC_ASSERT(m != NULL && r != NULL,
+                    "cannot get objects from an empty pool");
+  bitcoinrpc_objpool_put_method(pool, m);
+  bitcoinrpc_objpool_put_resp(pool, r);
+
+  accounting = bitcoinrpc_global_get_memstats(&ms0) == BITCOINRPCE_OK;
+  for (int i = 0; i < 100; i++)
+    {
+      m1 = bitcoinrpc_objpool_get_method(pool, BITCOINRPC_METHOD_GETMEMPOOLINFO, NULL);
+      r1 = bitcoinrpc_objpool_get_resp(pool);
+      BITCOINRPC_ASSERT(m1 == m && r1 == r,
+                        "the objects have not been reused");
+      BITCOINRPC_ASSERT(m1->m == BITCOINRPC_METHOD_GETMEMPOOLINFO
+                        && bitcoinrpc_resp_get_borrowed(r1) == NULL,
+                        "the objects have not been reset");
+      bitcoinrpc_objpool_put_method(pool, m1);
+      bitcoinrpc_objpool_put_resp(pool, r1);
+    }
+  if (accounting)
+    {
+      bitcoinrpc_global_get_memstats(&ms1);
+      BITCOINRPC_ASSERT(ms1.allocs == ms0.allocs,
+                        "the pool allocates in the steady state");
+    }
+
+  /* beyond the limit, objects are freed */
+  m = bitcoinrpc_objpool_get_method(pool, BITCOINRPC_METHOD_HELP, NULL);
+  m1 = bitcoinrpc_objpool_get_method(pool, BITCOINRPC_METHOD_HELP, NULL);
+  BITCOINRPC_ASSERT(m != NULL && m1 != NULL && m != m1,
+                    "cannot get two methods");
+  bitcoinrpc_objpool_put_method(pool, m);
+  bitcoinrpc_objpool_put_method(pool, m1);
+
+  BITCOINRPC_ASSERT(bitcoinrpc_objpool_free(pool) == BITCOINRPCE_OK,
+                    "cannot free the pool");
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+
 BITCOINRPC_TESTU(method)
 {
   BITCOINRPC_TESTU_INIT;
   BITCOINRPC_RUN_TEST(method_init, o, NULL);
   BITCOINRPC_RUN_TEST(method_params, o, NULL);
   BITCOINRPC_RUN_TEST(method_set_nonstandard, o, NULL);
+  BITCOINRPC_RUN_TEST(method_append_post, o, NULL);
+  BITCOINRPC_RUN_TEST(method_reset, o, NULL);
+  BITCOINRPC_RUN_TEST(method_set_param, o, NULL);
+  BITCOINRPC_RUN_TEST(method_objpool, o, NULL);
   BITCOINRPC_TESTU_RETURN(0);
 }
@@ -0,0 +1,278 @@
+/*
+   The MIT License (MIT)
+   Copyright (c) 2016 Marek Miller
+
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+   LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+   OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+   WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <jansson.h>
+
+#include "../src/bitcoinrpc.h"
+#include "bitcoinrpc_test.h"
+
+
+#define POOL_THREADS 8
+#define POOL_CALLS   50
+
+
+struct pool_worker {
+  bitcoinrpc_cl_t *cl;
+  size_t ok;
+};
+
+
+/* Call getconnectioncount POOL_CALLS times through the shared client */
+static void *
+pool_worker_run(void *arg)
+{
+  struct pool_worker *w = (struct pool_worker*)arg;
+  bitcoinrpc_method_t *m = NULL;
+  bitcoinrpc_resp_t *r = NULL;
+  bitcoinrpc_err_t e;
+  json_t *j = NULL;
+
+  m = bitcoinrpc_method_init(BITCOINRPC_METHOD_GETCONNECTIONCOUNT);
+  r = bitcoinrpc_resp_init();
+  if (NULL == m || NULL == r)
+    goto done;
+
+  for (size_t i = 0; i < POOL_CALLS; i++)
+    {
+      if (bitcoinrpc_call(w->cl, m, r, &e) != BITCOINRPCE_OK)
+        continue;
+
+      j = bitcoinrpc_resp_get(r);
+      if (json_is_integer(json_object_get(j, "result"))
+          && bitcoinrpc_resp_check(r, m) == BITCOINRPCE_OK)
+        w->ok++;
+      json_decref(j);
+    }
+
+done:
+  bitcoinrpc_resp_free(r);
+  bitcoinrpc_method_free(m);
+  return NULL;
+}
+
+
+/* More threads than connections: some of them have to wait for their turn */
+BITCOINRPC_TESTU(pool_threads)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = (bitcoinrpc_cl_t*)testdata;
+  pthread_t t[POOL_THREADS];
+  struct pool_worker w[POOL_THREADS];
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    {
+      w[i].cl = cl;
+      w[i].ok = 0;
+      BITCOINRPC_ASSERT(pthread_create(&t[i], NULL, pool_worker_run, &w[i]) == 0,
+                        "cannot start a new thread");
+    }
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    pthread_join(t[i], NULL);
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    BITCOINRPC_ASSERT(w[i].ok == POOL_CALLS,
+                      "at least one call through the pool failed");
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Every thread gets its own connection of a thread-safe client */
+BITCOINRPC_TESTU(pool_threadsafe)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+  pthread_t t[POOL_THREADS];
+  struct pool_worker w[POOL_THREADS];
+
+  cl = bitcoinrpc_cl_init_threadsafe(o.user, o.pass, o.addr, o.port);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new thread-safe client");
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    {
+      w[i].cl = cl;
+      w[i].ok = 0;
+      BITCOINRPC_ASSERT(pthread_create(&t[i], NULL, pool_worker_run, &w[i]) == 0,
+                        "cannot start a new thread");
+    }
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    pthread_join(t[i], NULL);
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    BITCOINRPC_ASSERT(w[i].ok == POOL_CALLS,
+                      "at least one call through the thread-safe client failed");
+
+  /* the connections of the threads that have exited can be used again */
+  w[0].ok = 0;
+  pool_worker_run(&w[0]);
+  BITCOINRPC_ASSERT(w[0].ok == POOL_CALLS,
+                    "cannot call the server from the main thread");
+
+  bitcoinrpc_cl_free(cl);
+  cl = NULL;
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* Calls of the same method made at the same time wait for one another */
+BITCOINRPC_TESTU(pool_single_flight)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+  pthread_t t[POOL_THREADS];
+  struct pool_worker w[POOL_THREADS];
+  bitcoinrpc_stats_t *stats = NULL;
+  size_t nstats = 0;
+  unsigned long long coalesced = 0, sent = 0;
+
+  cl = bitcoinrpc_cl_init_pool(o.user, o.pass, o.addr, o.port, 2);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_coalesced(cl, &coalesced) == BITCOINRPCE_ERR,
+                    "the single flight is not enabled, but calls are coalesced");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_single_flight(cl) == BITCOINRPCE_OK,
+                    "cannot enable the single flight");
+  bitcoinrpc_cl_enable_stats(cl);
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    {
+      w[i].cl = cl;
+      w[i].ok = 0;
+      BITCOINRPC_ASSERT(pthread_create(&t[i], NULL, pool_worker_run, &w[i]) == 0,
+                        "cannot start a new thread");
+    }
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    pthread_join(t[i], NULL);
+
+  /* every response has the id of its own method */
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    BITCOINRPC_ASSERT(w[i].ok == POOL_CALLS,
+                      "at least one call in the single flight failed");
+
+  /* a call is either sent or coalesced */
+  stats = bitcoinrpc_cl_get_stats(cl, &nstats);
+  for (size_t k = 0; k < nstats; k++)
+    sent += stats[k].calls;
+  bitcoinrpc_stats_free(stats);
+  bitcoinrpc_cl_get_coalesced(cl, &coalesced);
+  BITCOINRPC_ASSERT(sent + coalesced == POOL_THREADS * POOL_CALLS,
+                    "calls have been lost or counted twice");
+
+  bitcoinrpc_cl_free(cl);
+  cl = NULL;
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+/* The calls in flight stay within the limit, which adapts to the server */
+BITCOINRPC_TESTU(pool_limit)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+  pthread_t t[POOL_THREADS];
+  struct pool_worker w[POOL_THREADS];
+  bitcoinrpc_limitstats_t ls;
+
+  cl = bitcoinrpc_cl_init_pool(o.user, o.pass, o.addr, o.port, POOL_THREADS);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_limitstats(cl, &ls) == BITCOINRPCE_ERR,
+                    "the limit is not enabled, but there are counters");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_limit(cl, 0, 4, 0) == BITCOINRPCE_ARG
+                    && bitcoinrpc_cl_enable_limit(cl, 4, 2, 0) == BITCOINRPCE_ARG,
+                    "a wrong range of the limit accepted");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_limit(cl, 1, 4, POOL_THREADS) == BITCOINRPCE_OK,
+                    "cannot enable the limit");
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_enable_limit(cl, 1, 4, POOL_THREADS) == BITCOINRPCE_ERR,
+                    "the limit enabled twice");
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    {
+      w[i].cl = cl;
+      w[i].ok = 0;
+      BITCOINRPC_ASSERT(pthread_create(&t[i], NULL, pool_worker_run, &w[i]) == 0,
+                        "cannot start a new thread");
+    }
+
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    pthread_join(t[i], NULL);
+
+  /* the queue has room for every thread: no call fails */
+  for (size_t i = 0; i < POOL_THREADS; i++)
+    BITCOINRPC_ASSERT(w[i].ok == POOL_CALLS,
+                      "at least one call within the limit failed");
+
+  BITCOINRPC_ASSERT(bitcoinrpc_cl_get_limitstats(cl, &ls) == BITCOINRPCE_OK,
+                    "cannot get the counters of the limit");
+  BITCOINRPC_ASSERT(ls.limit >= 1 && ls.limit <= 4 && 0 == ls.inflight
+                    && 0 == ls.waiting && 0 == ls.rejected,
+                    "wrong counters of the limit");
+
+  bitcoinrpc_cl_free(cl);
+  cl = NULL;
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+BITCOINRPC_TESTU(pool)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_cl_t *cl = NULL;
+
+  cl = bitcoinrpc_cl_init_pool(o.user, o.pass, o.addr, o.port, 0);
+  BITCOINRPC_ASSERT(cl == NULL,
+                    "bitcoinrpc_cl_init_pool accepts an empty pool");
+
+  /* stay within bitcoind's default -rpcthreads */
+  cl = bitcoinrpc_cl_init_pool(o.user, o.pass, o.addr, o.port, 4);
+  BITCOINRPC_ASSERT(cl != NULL,
+                    "cannot initialise a new client");
+
+  BITCOINRPC_RUN_TEST(pool_threads, o, cl);
+
+  bitcoinrpc_cl_free(cl);
+  cl = NULL;
+
+  BITCOINRPC_RUN_TEST(pool_threadsafe, o, NULL);
+  BITCOINRPC_RUN_TEST(pool_single_flight, o, NULL);
+  BITCOINRPC_RUN_TEST(pool_limit, o, NULL);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
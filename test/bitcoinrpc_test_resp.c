@@ -116,10 +116,78 @@ BITCOINRPC_TESTU(resp_get)
 }
 
 
+BITCOINRPC_TESTU(resp_get_borrowed)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_resp_t *r = NULL;
+  json_t *j = NULL;
+
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(r != NULL,
+                    "cannot initialise a new response");
+
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_get_borrowed(r) == NULL,
+                    "a response object wrongly initialised");
+
+  /* the response takes the object parsed, not a copy of it */
+  j = json_pack("{s:i, s:n, s:i}", "result", 100, "error", "id", 1);
+  bitcoinrpc_resp_set_json_(r, j);
+  json_decref(j);
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_get_borrowed(r) == j,
+                    "the response object has been copied");
+  BITCOINRPC_ASSERT(json_integer_value(json_object_get(j, "result")) == 100,
+                    "the response object has not been kept");
+
+  bitcoinrpc_resp_set_json_(r, NULL);
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_get_borrowed(r) == NULL,
+                    "a response object wrongly reset");
+
+  bitcoinrpc_resp_free(r);
+  r = NULL;
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
+BITCOINRPC_TESTU(resp_reset)
+{
+  BITCOINRPC_TESTU_INIT;
+
+  bitcoinrpc_resp_t *r = NULL;
+  json_t *j = NULL;
+
+  r = bitcoinrpc_resp_init();
+  BITCOINRPC_ASSERT(r != NULL,
+                    "cannot initialise a new response");
+
+  j = json_pack("{s:i, s:n, s:i}", "result", 100, "error", "id", 1);
+  bitcoinrpc_resp_set_json_(r, j);
+  json_decref(j);
+  r->bytes = 42;
+  r->memstats.allocs = 3;
+
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_reset(r) == BITCOINRPCE_OK,
+                    "cannot reset the response");
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_get_borrowed(r) == NULL,
+                    "the response object has been kept");
+  BITCOINRPC_ASSERT(r->bytes == 0 && r->memstats.allocs == 0,
+                    "the response counters have been kept");
+  BITCOINRPC_ASSERT(bitcoinrpc_resp_reset(NULL) == BITCOINRPCE_ARG,
+                    "a NULL response reset");
+
+  bitcoinrpc_resp_free(r);
+
+  BITCOINRPC_TESTU_RETURN(0);
+}
+
+
 BITCOINRPC_TESTU(resp)
 {
   BITCOINRPC_TESTU_INIT;
   BITCOINRPC_RUN_TEST(resp_init, o, NULL);
   BITCOINRPC_RUN_TEST(resp_get, o, NULL);
+  BITCOINRPC_RUN_TEST(resp_get_borrowed, o, NULL);
+  BITCOINRPC_RUN_TEST(resp_reset, o, NULL);
   BITCOINRPC_TESTU_RETURN(0);
 }